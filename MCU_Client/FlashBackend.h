@@ -0,0 +1,102 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLASH_BACKEND_H_
+#define FLASH_BACKEND_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**< RAMFUNC attribute definition. Used to place function in RAM */
+#define RAMFUNC __attribute__((section(".fastrun"), noinline, noclone, optimize("Os")))
+
+#ifdef __MKL26Z64__
+#define FLASH_BASE_ADDR 0x0u /**< Flash is mapped from address 0 */
+#else
+#define FLASH_BASE_ADDR 0x10000000u /**< Host flash file is mapped at fixed address below 4 GB */
+#endif
+
+
+/*
+ *  Execute program longword command. Address and alignment checks are done by Flasher.
+ *
+ *  @param address       Destination pointer
+ *  @param word_value    Value to flash
+ *  @param reenable_irq  If true will leave IRQ enabled, disabled if false.
+ *  @return              Flasher return code
+ */
+RAMFUNC int FlashBackend_ProgramWord(uint32_t address, uint32_t word_value, bool reenable_irq);
+
+/*
+ *  Execute erase sector command. Address and alignment checks are done by Flasher.
+ *
+ *  @param address       Pointer to first byte in sector to be erased.
+ *  @param reenable_irq  If true will leave IRQ enabled, disabled if false.
+ *  @return              Flasher return code
+ */
+RAMFUNC int FlashBackend_EraseSector(uint32_t address, bool reenable_irq);
+
+/*
+ *  Disable interrupts before flash content used by running code is modified.
+ */
+RAMFUNC void FlashBackend_DisableIrq(void);
+
+/*
+ *  Restart CPU after firmware has been replaced.
+ */
+RAMFUNC void FlashBackend_Restart(void);
+
+/*
+ *  Get address of first byte after running firmware (code and initialized data).
+ *
+ *  @return        first free flash address.
+ */
+uint32_t FlashBackend_GetFirmwareEnd(void);
+
+#ifndef __MKL26Z64__
+/*
+ *  Open host flash simulation file, missing or short file is extended with erased bytes.
+ *
+ *  @param p_path              Path to flash image file
+ *  @param firmware_size       Size of simulated running firmware
+ *  @param program_latency_us  Duration of program longword command
+ *  @param erase_latency_us    Duration of erase sector command
+ *  @return                    Flasher return code
+ */
+int FlashBackend_Open(const char *p_path, size_t firmware_size, uint32_t program_latency_us, uint32_t erase_latency_us);
+
+/*
+ *  Flush and unmap host flash simulation file.
+ */
+void FlashBackend_Close(void);
+
+/*
+ *  Get number of flash commands executed since host flash simulation file was opened.
+ *
+ *  @param p_programs          [out] Number of program longword commands
+ *  @param p_erases            [out] Number of erase sector commands
+ */
+void FlashBackend_GetCommandCount(uint32_t *p_programs, uint32_t *p_erases);
+#endif
+
+#endif    // FLASH_BACKEND_H_
@@ -0,0 +1,198 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef __MKL26Z64__
+
+#include "FlashBackend.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Flasher.h"
+
+
+#define FLASH_SIZE 0x10000u               /**< Simulated flash size */
+#define FLASH_SECTOR_SIZE 0x400u          /**< Simulated flash sector size */
+#define FLASH_ERASED_WORD_VAL 0xFFFFFFFFu /**< Erased word value */
+
+
+static int      FlashFd          = -1;
+static uint8_t *FlashMemory      = NULL;
+static uint32_t FirmwareSize     = 0;
+static uint32_t ProgramLatencyUs = 0;
+static uint32_t EraseLatencyUs   = 0;
+static uint32_t ProgramCount     = 0;
+static uint32_t EraseCount       = 0;
+
+
+/*
+ *  Check if address range lies in simulated flash.
+ *
+ *  @param address       Pointer to first byte
+ *  @param len           Number of bytes
+ *  @return              True if whole range is in simulated flash.
+ */
+static bool FlashBackend_IsInFlash(uint32_t address, size_t len);
+
+
+int FlashBackend_Open(const char *p_path, size_t firmware_size, uint32_t program_latency_us, uint32_t erase_latency_us)
+{
+    FlashBackend_Close();
+
+    FlashFd = open(p_path, O_RDWR | O_CREAT, 0644);
+    if (FlashFd < 0)
+    {
+        return FLASHER_ERROR_ACCESS;
+    }
+
+    struct stat file_stat;
+    if (fstat(FlashFd, &file_stat) != 0)
+    {
+        FlashBackend_Close();
+        return FLASHER_ERROR_ACCESS;
+    }
+
+    // New flash is erased, file is extended with erased bytes.
+    uint8_t erased[FLASH_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    for (off_t offset = file_stat.st_size; offset < (off_t)FLASH_SIZE; offset += sizeof(erased))
+    {
+        size_t remaining = FLASH_SIZE - (size_t)offset;
+        size_t len       = remaining < sizeof(erased) ? remaining : sizeof(erased);
+        if (pwrite(FlashFd, erased, len, offset) != (ssize_t)len)
+        {
+            FlashBackend_Close();
+            return FLASHER_ERROR_ACCESS;
+        }
+    }
+
+    void *p_map = mmap((void *)(uintptr_t)FLASH_BASE_ADDR,
+                       FLASH_SIZE,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED_NOREPLACE,
+                       FlashFd,
+                       0);
+    if (p_map != (void *)(uintptr_t)FLASH_BASE_ADDR)
+    {
+        FlashBackend_Close();
+        return FLASHER_ERROR_ACCESS;
+    }
+
+    FlashMemory      = (uint8_t *)p_map;
+    FirmwareSize     = firmware_size;
+    ProgramLatencyUs = program_latency_us;
+    EraseLatencyUs   = erase_latency_us;
+    ProgramCount     = 0;
+    EraseCount       = 0;
+
+    return FLASHER_SUCCESS;
+}
+
+void FlashBackend_Close(void)
+{
+    if (FlashMemory != NULL)
+    {
+        msync(FlashMemory, FLASH_SIZE, MS_SYNC);
+        munmap(FlashMemory, FLASH_SIZE);
+        FlashMemory = NULL;
+    }
+
+    if (FlashFd >= 0)
+    {
+        close(FlashFd);
+        FlashFd = -1;
+    }
+}
+
+int FlashBackend_ProgramWord(uint32_t address, uint32_t word_value, bool reenable_irq)
+{
+    if (!FlashBackend_IsInFlash(address, sizeof(uint32_t)))
+    {
+        return FLASHER_ERROR_PROTECTION;
+    }
+
+    ProgramCount++;
+    if (ProgramLatencyUs != 0)
+    {
+        usleep(ProgramLatencyUs);
+    }
+
+    // Like FTFL, programming of not erased longword is rejected and leaves it unchanged.
+    uint32_t *p_word = (uint32_t *)(FlashMemory + address - FLASH_BASE_ADDR);
+    if (*p_word != FLASH_ERASED_WORD_VAL)
+    {
+        return FLASHER_ERROR_ACCESS;
+    }
+
+    *p_word = word_value;
+    return FLASHER_SUCCESS;
+}
+
+int FlashBackend_EraseSector(uint32_t address, bool reenable_irq)
+{
+    if (!FlashBackend_IsInFlash(address, FLASH_SECTOR_SIZE) || (address - FLASH_BASE_ADDR) % FLASH_SECTOR_SIZE != 0)
+    {
+        return FLASHER_ERROR_ACCESS;
+    }
+
+    EraseCount++;
+    if (EraseLatencyUs != 0)
+    {
+        usleep(EraseLatencyUs);
+    }
+
+    memset(FlashMemory + address - FLASH_BASE_ADDR, 0xFF, FLASH_SECTOR_SIZE);
+    return FLASHER_SUCCESS;
+}
+
+void FlashBackend_DisableIrq(void)
+{
+}
+
+void FlashBackend_Restart(void)
+{
+    FlashBackend_Close();
+    exit(EXIT_SUCCESS);
+}
+
+uint32_t FlashBackend_GetFirmwareEnd(void)
+{
+    return FLASH_BASE_ADDR + FirmwareSize;
+}
+
+void FlashBackend_GetCommandCount(uint32_t *p_programs, uint32_t *p_erases)
+{
+    *p_programs = ProgramCount;
+    *p_erases   = EraseCount;
+}
+
+
+static bool FlashBackend_IsInFlash(uint32_t address, size_t len)
+{
+    return FlashMemory != NULL && address >= FLASH_BASE_ADDR && address + len <= FLASH_BASE_ADDR + FLASH_SIZE;
+}
+
+#endif    // __MKL26Z64__
@@ -22,31 +22,15 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "Flasher.h"
 
-#include <kinetis.h>
 #include <stdint.h>
 
 
-#define FLASH_END_ADDR 0x10000u                   /**< Pointer to end of flash. */
-#define FLASH_SECTOR_SIZE 0x400u                  /**< Flash sector size */
-#define FLASH_EEPROM_SIZE (2 * FLASH_SECTOR_SIZE) /**< Size of space reserved for dummy eeprom */
-#define FLASH_CONFIG_FIELD_ADDR 0x40u             /**< Config field address */
-#define FLASH_CONFIG_FIELD_VAL 0xFFFFFFFEu        /**< Config field desirable value */
-#define FLASH_ERASED_WORD_VAL 0xFFFFFFFFu         /**< Erased word value */
-#define FLASH_WRITE_WORD_CMD 0x06                 /**< Flash write word command code */
-#define FLASH_ERASE_SECTOR_CMD 0x09               /**< Flash sector erase command code */
-#define CPU_RESTART_ADDR ((uint32_t *)0xE000ED0C) /**< CPU restart register address */
-#define CPU_RESTART_VAL 0x5FA0004                 /**< CPU restart register value  */
-
-/**< Data memory barrier instruction definition. */
-#define _DMB()                 \
-    do                         \
-    {                          \
-        __asm volatile("dmb"); \
-    } while (0)
-
-extern unsigned long _etext; /**< End of .text section label */
-extern unsigned long _sdata; /**< Start of .data section label */
-extern unsigned long _edata; /**< Ennd of .data section label */
+#define FLASH_END_ADDR (FLASH_BASE_ADDR + 0x10000u)       /**< Pointer to end of flash. */
+#define FLASH_SECTOR_SIZE 0x400u                          /**< Flash sector size */
+#define FLASH_EEPROM_SIZE (2 * FLASH_SECTOR_SIZE)         /**< Size of space reserved for dummy eeprom */
+#define FLASH_CONFIG_FIELD_ADDR (FLASH_BASE_ADDR + 0x40u) /**< Config field address */
+#define FLASH_CONFIG_FIELD_VAL 0xFFFFFFFEu                /**< Config field desirable value */
+#define FLASH_ERASED_WORD_VAL 0xFFFFFFFFu                 /**< Erased word value */
 
 
 /*
@@ -59,6 +43,15 @@ extern unsigned long _edata; /**< Ennd of .data section label */
  */
 RAMFUNC static int Flasher_FlashWordNotEeprom(uint32_t address, uint32_t word_value, bool reenable_irq);
 
+/*
+ *  Copy sector of firmware, sector is not erased if it already contains the same data.
+ *
+ *  @param destination   Pointer to first byte in destination sector
+ *  @param source        Pointer to data to copy
+ *  @param num_of_words  Number of words to copy
+ */
+RAMFUNC static void Flasher_CopySector(uint32_t destination, uint32_t source, uint32_t num_of_words);
+
 /*
  *  Erase sector.
  *
@@ -69,32 +62,61 @@ RAMFUNC static int Flasher_FlashWordNotEeprom(uint32_t address, uint32_t word_va
  */
 RAMFUNC static int Flasher_SectorErase(uint32_t address, bool unsafe, bool reenable_irq);
 
+/*
+ *  Execute sector erase command without range checks.
+ *
+ *  @param address       Pointer to first byte in sector to be erased.
+ *  @param reenable_irq  If true will leave IRQ enabled, disabled if false.
+ *  @return              Flasher return code
+ */
+RAMFUNC static int Flasher_SectorEraseCmd(uint32_t address, bool reenable_irq);
+
+/*
+ *  Program run of words with single erased check before and single verify after programming.
+ *  Words equal to erased value are not programmed. Range has to be checked by caller.
+ *
+ *  @param address         Destination pointer
+ *  @param src             Source pointer
+ *  @param num_of_words    Number of words to program
+ *  @return                Flasher return code
+ */
+static int Flasher_ProgramWords(uint32_t address, const uint32_t *src, uint32_t num_of_words);
 
-RAMFUNC int Flasher_UpdateFirmware(uint32_t num_of_words)
+/*
+ *  Check if address range lies in eeprom space.
+ *
+ *  @param address       Pointer to first byte
+ *  @param len           Number of bytes
+ *  @return              True if whole range is in eeprom space.
+ */
+static bool Flasher_IsInEeprom(uint32_t address, size_t len);
+
+
+RAMFUNC int Flasher_UpdateFirmware(uint32_t src, uint32_t num_of_words)
 {
-    uint32_t src = Flasher_GetSpaceAddr();
-    uint32_t dst = 0;
+    uint32_t image_len   = (num_of_words + 1) * 4;
+    uint32_t num_sectors = (image_len + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE;
 
-    __disable_irq();
+    // Sector with vector table is written last if new firmware doesn't overlap with the stored image.
+    // The copy is not power fail safe anyway: copied backwards it replaces initialized data and RAM
+    // functions of the running firmware first, copied forwards the vector table and startup code.
+    // Interrupted copy leaves a mix of both images, which in general doesn't start and has to be
+    // reprogrammed with the Teensy bootloader.
+    bool backwards = (image_len <= src - FLASH_BASE_ADDR);
 
-    for (uint32_t i = 0; i <= num_of_words; i++)
-    {
-        uint32_t source      = src + i * 4;
-        uint32_t destination = dst + i * 4;
+    FlashBackend_DisableIrq();
 
-        if (destination % FLASH_SECTOR_SIZE == 0)
-        {
-            Flasher_SectorErase(destination, true, false);
-            if (destination + FLASH_SECTOR_SIZE > FLASH_CONFIG_FIELD_ADDR && destination <= FLASH_CONFIG_FIELD_ADDR)
-            {
-                Flasher_FlashWordNotEeprom(FLASH_CONFIG_FIELD_ADDR, FLASH_CONFIG_FIELD_VAL, false);
-            }
-        }
+    for (uint32_t i = 0; i < num_sectors; i++)
+    {
+        uint32_t sector    = backwards ? (num_sectors - 1 - i) : i;
+        uint32_t offset    = sector * FLASH_SECTOR_SIZE;
+        uint32_t remaining = (image_len - offset) / 4;
+        uint32_t words     = remaining < FLASH_SECTOR_SIZE / 4 ? remaining : FLASH_SECTOR_SIZE / 4;
 
-        Flasher_FlashWordNotEeprom(destination, *(volatile uint32_t *)source, false);
+        Flasher_CopySector(FLASH_BASE_ADDR + offset, src + offset, words);
     }
 
-    *CPU_RESTART_ADDR = CPU_RESTART_VAL;
+    FlashBackend_Restart();
 
     return FLASHER_SUCCESS;
 }
@@ -112,60 +134,24 @@ RAMFUNC int Flasher_FlashWord(uint32_t address, uint32_t word_value, bool reenab
         return FLASHER_SUCCESS;
     }
 
-    if (*(volatile uint32_t *)address == word_value)
+    if (*(volatile uint32_t *)(uintptr_t)address == word_value)
     {
         return FLASHER_SUCCESS;
     }
 
-    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
-    {
-    };
-    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
-
-    *(uint32_t *)&FTFL_FCCOB3 = address;
-    *(uint32_t *)&FTFL_FCCOB7 = word_value;
-    FTFL_FCCOB0               = FLASH_WRITE_WORD_CMD;
-
-    __disable_irq();
-
-    FTFL_FSTAT = FTFL_FSTAT_CCIF;
-    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
-    {
-    };
-    MCM_PLACR |= MCM_PLACR_CFCC;
-
-    _DMB();
+    int ret_val = FlashBackend_ProgramWord(address, word_value, reenable_irq);
 
-    if (reenable_irq)
-        __enable_irq();
-
-    if (*(volatile uint32_t *)address != word_value)
+    if (*(volatile uint32_t *)(uintptr_t)address != word_value)
     {
         return FLASHER_ERROR_VERIFY;
     }
-    if (FTFL_FSTAT & FTFL_FSTAT_RDCOLERR)
-    {
-        return FLASHER_ERROR_COLLISION;
-    }
-    if (FTFL_FSTAT & FTFL_FSTAT_ACCERR)
-    {
-        return FLASHER_ERROR_ACCESS;
-    }
-    if (FTFL_FSTAT & FTFL_FSTAT_FPVIOL)
-    {
-        return FLASHER_ERROR_PROTECTION;
-    }
-    if (FTFL_FSTAT & FTFL_FSTAT_MGSTAT0)
-    {
-        return FLASHER_ERROR_CONTROLLER;
-    }
 
-    return FLASHER_SUCCESS;
+    return ret_val;
 }
 
 uint32_t Flasher_GetSpaceAddr(void)
 {
-    uint32_t first_free_addr = (uint32_t)&_etext + (uint32_t)&_edata - (uint32_t)&_sdata;
+    uint32_t first_free_addr = FlashBackend_GetFirmwareEnd();
     return (FLASH_SECTOR_SIZE * ((first_free_addr / FLASH_SECTOR_SIZE) + 1));
 }
 
@@ -176,7 +162,14 @@ size_t Flasher_GetSpaceSize(void)
 
 int Flasher_EraseSpace(void)
 {
-    for (uint32_t p_sector = Flasher_GetSpaceAddr(); p_sector < FLASH_END_ADDR; p_sector += FLASH_SECTOR_SIZE)
+    return Flasher_EraseSpaceFrom(0);
+}
+
+int Flasher_EraseSpaceFrom(size_t offset)
+{
+    uint32_t first_sector = Flasher_GetSpaceAddr() + offset - offset % FLASH_SECTOR_SIZE;
+
+    for (uint32_t p_sector = first_sector; p_sector < FLASH_END_ADDR - FLASH_EEPROM_SIZE; p_sector += FLASH_SECTOR_SIZE)
     {
         int ret_val = Flasher_SectorErase(p_sector, false, true);
 
@@ -196,18 +189,57 @@ int Flasher_SaveMemoryToFlash(uint32_t address, const uint32_t *src, uint32_t nu
         return FLASHER_ERROR_ALIGNMENT;
     }
 
-    for (uint32_t i = 0; i < num_of_words; i++)
+    if (address + num_of_words * sizeof(uint32_t) > FLASH_END_ADDR - FLASH_EEPROM_SIZE)
     {
-        uint32_t word_to_flash = *(src + i);
-        int      ret_val       = Flasher_FlashWordNotEeprom(address + i * 4, word_to_flash, true);
+        return FLASHER_ERROR_RANGE;
+    }
 
-        if (ret_val != FLASHER_SUCCESS)
-        {
-            return ret_val;
-        }
+    return Flasher_ProgramWords(address, src, num_of_words);
+}
+
+uint32_t Flasher_GetEepromAddr(void)
+{
+    return FLASH_END_ADDR - FLASH_EEPROM_SIZE;
+}
+
+size_t Flasher_GetEepromSize(void)
+{
+    return FLASH_EEPROM_SIZE;
+}
+
+size_t Flasher_GetSectorSize(void)
+{
+    return FLASH_SECTOR_SIZE;
+}
+
+int Flasher_EraseEepromSector(uint32_t address)
+{
+    if (!Flasher_IsInEeprom(address, FLASH_SECTOR_SIZE))
+    {
+        return FLASHER_ERROR_RANGE;
     }
 
-    return FLASHER_SUCCESS;
+    if (address % FLASH_SECTOR_SIZE != 0)
+    {
+        return FLASHER_ERROR_ALIGNMENT;
+    }
+
+    return Flasher_SectorEraseCmd(address, true);
+}
+
+int Flasher_SaveMemoryToEeprom(uint32_t address, const uint32_t *src, uint32_t num_of_words)
+{
+    if (address % sizeof(uint32_t) != 0)
+    {
+        return FLASHER_ERROR_ALIGNMENT;
+    }
+
+    if (!Flasher_IsInEeprom(address, num_of_words * sizeof(uint32_t)))
+    {
+        return FLASHER_ERROR_RANGE;
+    }
+
+    return Flasher_ProgramWords(address, src, num_of_words);
 }
 
 
@@ -218,7 +250,7 @@ RAMFUNC int Flasher_FlashWordNotEeprom(uint32_t address, uint32_t word_value, bo
         return FLASHER_ERROR_RANGE;
     }
 
-    if (*(volatile uint32_t *)address != FLASH_ERASED_WORD_VAL)
+    if (*(volatile uint32_t *)(uintptr_t)address != FLASH_ERASED_WORD_VAL)
     {
         return FLASHER_ERROR_NOT_ERASED;
     }
@@ -232,6 +264,36 @@ RAMFUNC int Flasher_FlashWordNotEeprom(uint32_t address, uint32_t word_value, bo
     }
 }
 
+RAMFUNC void Flasher_CopySector(uint32_t destination, uint32_t source, uint32_t num_of_words)
+{
+    bool is_equal = true;
+    for (uint32_t i = 0; i < num_of_words && is_equal; i++)
+    {
+        uint32_t address = destination + i * 4;
+        if (address != FLASH_CONFIG_FIELD_ADDR &&
+            *(volatile uint32_t *)(uintptr_t)address != *(volatile uint32_t *)(uintptr_t)(source + i * 4))
+        {
+            is_equal = false;
+        }
+    }
+
+    if (is_equal)
+    {
+        return;
+    }
+
+    Flasher_SectorErase(destination, true, false);
+    if (destination + FLASH_SECTOR_SIZE > FLASH_CONFIG_FIELD_ADDR && destination <= FLASH_CONFIG_FIELD_ADDR)
+    {
+        Flasher_FlashWordNotEeprom(FLASH_CONFIG_FIELD_ADDR, FLASH_CONFIG_FIELD_VAL, false);
+    }
+
+    for (uint32_t i = 0; i < num_of_words; i++)
+    {
+        Flasher_FlashWordNotEeprom(destination + i * 4, *(volatile uint32_t *)(uintptr_t)(source + i * 4), false);
+    }
+}
+
 RAMFUNC int Flasher_SectorErase(uint32_t address, bool unsafe, bool reenable_irq)
 {
     if (address >= FLASH_END_ADDR - FLASH_EEPROM_SIZE)
@@ -249,44 +311,55 @@ RAMFUNC int Flasher_SectorErase(uint32_t address, bool unsafe, bool reenable_irq
         return FLASHER_ERROR_UNSAFE;
     }
 
-    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
-    {
-    };
-
-    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
+    return Flasher_SectorEraseCmd(address, reenable_irq);
+}
 
-    *(uint32_t *)&FTFL_FCCOB3 = address;
-    FTFL_FCCOB0               = FLASH_ERASE_SECTOR_CMD;
+RAMFUNC int Flasher_SectorEraseCmd(uint32_t address, bool reenable_irq)
+{
+    return FlashBackend_EraseSector(address, reenable_irq);
+}
 
-    __disable_irq();
+static int Flasher_ProgramWords(uint32_t address, const uint32_t *src, uint32_t num_of_words)
+{
+    const volatile uint32_t *p_dst = (const volatile uint32_t *)(uintptr_t)address;
 
-    FTFL_FSTAT = FTFL_FSTAT_CCIF;
-    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
+    for (uint32_t i = 0; i < num_of_words; i++)
     {
+        if (p_dst[i] != FLASH_ERASED_WORD_VAL)
+        {
+            return FLASHER_ERROR_NOT_ERASED;
+        }
     }
-    MCM_PLACR |= MCM_PLACR_CFCC;
 
-    _DMB();
+    for (uint32_t i = 0; i < num_of_words; i++)
+    {
+        uint32_t word_address = address + i * 4;
 
-    if (reenable_irq)
-        __enable_irq();
+        // Erased words already have desired value, padding in images is skipped this way.
+        if (src[i] == FLASH_ERASED_WORD_VAL || word_address == FLASH_CONFIG_FIELD_ADDR)
+        {
+            continue;
+        }
 
-    if (FTFL_FSTAT & FTFL_FSTAT_RDCOLERR)
-    {
-        return FLASHER_ERROR_COLLISION;
-    }
-    if (FTFL_FSTAT & FTFL_FSTAT_ACCERR)
-    {
-        return FLASHER_ERROR_ACCESS;
-    }
-    if (FTFL_FSTAT & FTFL_FSTAT_FPVIOL)
-    {
-        return FLASHER_ERROR_PROTECTION;
+        int ret_val = FlashBackend_ProgramWord(word_address, src[i], true);
+        if (ret_val != FLASHER_SUCCESS)
+        {
+            return ret_val;
+        }
     }
-    if (FTFL_FSTAT & FTFL_FSTAT_MGSTAT0)
+
+    for (uint32_t i = 0; i < num_of_words; i++)
     {
-        return FLASHER_ERROR_CONTROLLER;
+        if (p_dst[i] != src[i] && address + i * 4 != FLASH_CONFIG_FIELD_ADDR)
+        {
+            return FLASHER_ERROR_VERIFY;
+        }
     }
 
     return FLASHER_SUCCESS;
 }
+
+static bool Flasher_IsInEeprom(uint32_t address, size_t len)
+{
+    return address >= Flasher_GetEepromAddr() && address + len <= FLASH_END_ADDR;
+}
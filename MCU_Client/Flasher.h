@@ -26,13 +26,8 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <stddef.h>
 #include <stdint.h>
 
+#include "FlashBackend.h"
 
-#ifndef __MKL26Z64__
-#error "Flash support available only on MKL26Z64"
-#endif
-
-/**< RAMFUNC attribute definition. Used to place function in RAM */
-#define RAMFUNC __attribute__((section(".fastrun"), noinline, noclone, optimize("Os")))
 
 /**< Flasher return codes*/
 #define FLASHER_SUCCESS 0
@@ -49,12 +44,14 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 /*
  *  Copy stored firmware to the beggining of flash and reboots.
- *  If success will never return.
+ *  Sectors already containing new firmware are not rewritten. The copy is not power fail safe,
+ *  firmware interrupted in the middle of it may not start again. If success will never return.
  *
+ *  @param src             Address of stored firmware image.
  *  @param num_of_words    Size of firmware image.
  *  @return                Flasher return code.
  */
-RAMFUNC int Flasher_UpdateFirmware(uint32_t num_of_words);
+RAMFUNC int Flasher_UpdateFirmware(uint32_t src, uint32_t num_of_words);
 
 /*
  *  Save word to flash.
@@ -87,6 +84,14 @@ size_t Flasher_GetSpaceSize(void);
  */
 int Flasher_EraseSpace(void);
 
+/*
+ *  Erase storage space starting with sector containing offset.
+ *
+ *  @param offset  Offset in storage space
+ *  @return        Flasher return code
+ */
+int Flasher_EraseSpaceFrom(size_t offset);
+
 /*
  *  Saves words to flash.
  *  Destination should be already erased with Flasher_EraseSpace.
@@ -98,4 +103,44 @@ int Flasher_EraseSpace(void);
  */
 int Flasher_SaveMemoryToFlash(uint32_t address, const uint32_t *src, uint32_t num_of_words);
 
+/*
+ *  Get pointer to beggining of space reserved for dummy eeprom.
+ *
+ *  @return        eeprom space address.
+ */
+uint32_t Flasher_GetEepromAddr(void);
+
+/*
+ *  Get number of bytes in space reserved for dummy eeprom.
+ *
+ *  @return        number of bytes reserved.
+ */
+size_t Flasher_GetEepromSize(void);
+
+/*
+ *  Get flash sector size.
+ *
+ *  @return        sector size in bytes.
+ */
+size_t Flasher_GetSectorSize(void);
+
+/*
+ *  Erase single sector of eeprom space.
+ *
+ *  @param address   Pointer to first byte in sector to be erased.
+ *  @return          Flasher return code
+ */
+int Flasher_EraseEepromSector(uint32_t address);
+
+/*
+ *  Saves words to eeprom space.
+ *  Destination should be already erased with Flasher_EraseEepromSector.
+ *
+ *  @param address         Destination pointer
+ *  @param src             Source pointer
+ *  @param num_of_words    Size of data to copy
+ *  @return                Flasher return code
+ */
+int Flasher_SaveMemoryToEeprom(uint32_t address, const uint32_t *src, uint32_t num_of_words);
+
 #endif    // FLASHER_H_
\ No newline at end of file
@@ -0,0 +1,349 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "KVStore.h"
+
+#include <string.h>
+
+#include "CRC.h"
+#include "Flasher.h"
+
+
+#define KV_SECTOR_MAGIC 0x3153564Bu /**< "KVS1" in little endian */
+#define KV_SECTOR_COUNT 2u          /**< Sectors used alternately, one is active, the other one is compaction target */
+#define KV_ERASED_WORD 0xFFFFFFFFu  /**< Erased word value, marks end of log */
+#define KV_RECORD_WORDS(len) (1u + ((len) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+#define KV_DELETED_LEN 0u /**< Record without value removes the key */
+
+/**< Record header word layout */
+#define KV_HEADER_KEY(header) ((uint8_t)(header))
+#define KV_HEADER_LEN(header) ((uint8_t)((header) >> 8))
+#define KV_HEADER_CRC(header) ((uint16_t)((header) >> 16))
+
+
+/*
+ *  Sector header, written after sector content is complete
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence; /**< Incremented with every compaction, higher one is active */
+} KVSectorHeader_T;
+
+
+static uint32_t ActiveSector = 0; /**< Address of active sector */
+static size_t   WriteOffset  = 0; /**< Offset of first free word in active sector */
+
+
+/*
+ *  Get address of store sector
+ *
+ *  @param index     Sector index
+ *  @return          Sector address
+ */
+static uint32_t KVStore_GetSectorAddr(size_t index);
+
+/*
+ *  Find end of log in sector
+ *
+ *  @param sector    Sector address
+ *  @return          Offset of first free word
+ */
+static size_t KVStore_FindEnd(uint32_t sector);
+
+/*
+ *  Find latest valid record of the key
+ *
+ *  @param sector    Sector address
+ *  @param end       Offset of end of log
+ *  @param key       Key
+ *  @return          Record address, 0 if not found
+ */
+static uint32_t KVStore_Find(uint32_t sector, size_t end, uint8_t key);
+
+/*
+ *  Calculate record CRC
+ *
+ *  @param key       Key
+ *  @param len       Value length
+ *  @param p_value   Value
+ *  @return          CRC16 of key, length and value
+ */
+static uint16_t KVStore_CalcCRC(uint8_t key, uint8_t len, const uint8_t *p_value);
+
+/*
+ *  Append record to sector
+ *
+ *  @param sector    Sector address
+ *  @param p_offset  [in/out] Offset of first free word
+ *  @param key       Key
+ *  @param p_value   Value
+ *  @param len       Value length
+ *  @return          Key value store return code
+ */
+static int KVStore_Append(uint32_t sector, size_t *p_offset, uint8_t key, const uint8_t *p_value, size_t len);
+
+/*
+ *  Append record to active sector, compact the store first if there is no space left
+ *
+ *  @param key       Key
+ *  @param p_value   Value
+ *  @param len       Value length
+ *  @return          Key value store return code
+ */
+static int KVStore_Put(uint8_t key, const uint8_t *p_value, size_t len);
+
+/*
+ *  Copy latest values to the other sector and make it active
+ *
+ *  @return          Key value store return code
+ */
+static int KVStore_Compact(void);
+
+
+void KVStore_Init(void)
+{
+    ActiveSector      = 0;
+    uint32_t sequence = 0;
+
+    for (size_t i = 0; i < KV_SECTOR_COUNT; i++)
+    {
+        uint32_t                sector   = KVStore_GetSectorAddr(i);
+        const KVSectorHeader_T *p_header = (const KVSectorHeader_T *)(uintptr_t)sector;
+        if (p_header->magic == KV_SECTOR_MAGIC && (ActiveSector == 0 || p_header->sequence > sequence))
+        {
+            ActiveSector = sector;
+            sequence     = p_header->sequence;
+        }
+    }
+
+    if (ActiveSector == 0)
+    {
+        KVSectorHeader_T header = {KV_SECTOR_MAGIC, 0};
+
+        ActiveSector = KVStore_GetSectorAddr(0);
+        Flasher_EraseEepromSector(ActiveSector);
+        Flasher_SaveMemoryToEeprom(ActiveSector, (uint32_t *)&header, sizeof(header) / sizeof(uint32_t));
+    }
+
+    WriteOffset = KVStore_FindEnd(ActiveSector);
+}
+
+int KVStore_Read(uint8_t key, void *p_value, size_t len)
+{
+    uint32_t record = KVStore_Find(ActiveSector, WriteOffset, key);
+    if (record == 0)
+    {
+        return KV_STORE_ERROR_NOT_FOUND;
+    }
+
+    uint32_t header = *(const uint32_t *)(uintptr_t)record;
+    if (KV_HEADER_LEN(header) == KV_DELETED_LEN)
+    {
+        return KV_STORE_ERROR_NOT_FOUND;
+    }
+    if (KV_HEADER_LEN(header) != len)
+    {
+        return KV_STORE_ERROR_SIZE;
+    }
+
+    memcpy(p_value, (const uint8_t *)(uintptr_t)record + sizeof(uint32_t), len);
+    return KV_STORE_SUCCESS;
+}
+
+int KVStore_Write(uint8_t key, const void *p_value, size_t len)
+{
+    if (len == KV_DELETED_LEN || len > KV_STORE_MAX_VALUE_LEN)
+    {
+        return KV_STORE_ERROR_SIZE;
+    }
+
+    uint32_t record = KVStore_Find(ActiveSector, WriteOffset, key);
+    if (record != 0 && KV_HEADER_LEN(*(const uint32_t *)(uintptr_t)record) == len &&
+        memcmp((const uint8_t *)(uintptr_t)record + sizeof(uint32_t), p_value, len) == 0)
+    {
+        return KV_STORE_SUCCESS;
+    }
+
+    return KVStore_Put(key, (const uint8_t *)p_value, len);
+}
+
+int KVStore_Delete(uint8_t key)
+{
+    uint32_t record = KVStore_Find(ActiveSector, WriteOffset, key);
+    if (record == 0 || KV_HEADER_LEN(*(const uint32_t *)(uintptr_t)record) == KV_DELETED_LEN)
+    {
+        return KV_STORE_SUCCESS;
+    }
+
+    return KVStore_Put(key, NULL, KV_DELETED_LEN);
+}
+
+
+static uint32_t KVStore_GetSectorAddr(size_t index)
+{
+    return Flasher_GetEepromAddr() + index * Flasher_GetSectorSize();
+}
+
+static size_t KVStore_FindEnd(uint32_t sector)
+{
+    size_t offset = sizeof(KVSectorHeader_T);
+
+    while (offset < Flasher_GetSectorSize())
+    {
+        uint32_t header = *(const uint32_t *)(sector + offset);
+        if (header == KV_ERASED_WORD)
+        {
+            break;
+        }
+
+        // Records with bad CRC are skipped, header is still valid as it is programmed as one word.
+        offset += KV_RECORD_WORDS(KV_HEADER_LEN(header)) * sizeof(uint32_t);
+    }
+
+    return offset < Flasher_GetSectorSize() ? offset : Flasher_GetSectorSize();
+}
+
+static uint32_t KVStore_Find(uint32_t sector, size_t end, uint8_t key)
+{
+    uint32_t found  = 0;
+    size_t   offset = sizeof(KVSectorHeader_T);
+
+    while (offset < end)
+    {
+        uint32_t       record  = sector + offset;
+        uint32_t       header  = *(const uint32_t *)(uintptr_t)record;
+        const uint8_t *p_value = (const uint8_t *)(uintptr_t)record + sizeof(uint32_t);
+
+        offset += KV_RECORD_WORDS(KV_HEADER_LEN(header)) * sizeof(uint32_t);
+        if (offset > end)
+        {
+            break;
+        }
+
+        if (KV_HEADER_KEY(header) == key &&
+            KV_HEADER_CRC(header) == KVStore_CalcCRC(key, KV_HEADER_LEN(header), p_value))
+        {
+            found = record;
+        }
+    }
+
+    return found;
+}
+
+static uint16_t KVStore_CalcCRC(uint8_t key, uint8_t len, const uint8_t *p_value)
+{
+    uint8_t  key_len[] = {key, len};
+    uint16_t crc       = CalcCRC16(key_len, sizeof(key_len), CRC16_INIT_VAL);
+    return CalcCRC16((uint8_t *)p_value, len, crc);
+}
+
+static int KVStore_Append(uint32_t sector, size_t *p_offset, uint8_t key, const uint8_t *p_value, size_t len)
+{
+    uint32_t record[KV_RECORD_WORDS(KV_STORE_MAX_VALUE_LEN)];
+    size_t   words = KV_RECORD_WORDS(len);
+
+    if (*p_offset + words * sizeof(uint32_t) > Flasher_GetSectorSize())
+    {
+        return KV_STORE_ERROR_SIZE;
+    }
+
+    record[words - 1] = KV_ERASED_WORD;
+    if (len != KV_DELETED_LEN)
+    {
+        memcpy(record + 1, p_value, len);
+    }
+    record[0] = key | ((uint32_t)len << 8) | ((uint32_t)KVStore_CalcCRC(key, len, p_value) << 16);
+
+    if (Flasher_SaveMemoryToEeprom(sector + *p_offset, record, words) != FLASHER_SUCCESS)
+    {
+        // Partially written record can't be reused, skip it.
+        *p_offset = KVStore_FindEnd(sector);
+        return KV_STORE_ERROR_FLASH;
+    }
+
+    *p_offset += words * sizeof(uint32_t);
+    return KV_STORE_SUCCESS;
+}
+
+static int KVStore_Put(uint8_t key, const uint8_t *p_value, size_t len)
+{
+    if (WriteOffset + KV_RECORD_WORDS(len) * sizeof(uint32_t) > Flasher_GetSectorSize())
+    {
+        int ret_val = KVStore_Compact();
+        if (ret_val != KV_STORE_SUCCESS)
+        {
+            return ret_val;
+        }
+    }
+
+    return KVStore_Append(ActiveSector, &WriteOffset, key, p_value, len);
+}
+
+static int KVStore_Compact(void)
+{
+    const KVSectorHeader_T *p_active = (const KVSectorHeader_T *)(uintptr_t)ActiveSector;
+
+    uint32_t target = KVStore_GetSectorAddr(0) == ActiveSector ? KVStore_GetSectorAddr(1) : KVStore_GetSectorAddr(0);
+    size_t   offset = sizeof(KVSectorHeader_T);
+
+    if (Flasher_EraseEepromSector(target) != FLASHER_SUCCESS)
+    {
+        return KV_STORE_ERROR_FLASH;
+    }
+
+    for (size_t key = 0; key < UINT8_MAX; key++)
+    {
+        uint32_t record = KVStore_Find(ActiveSector, WriteOffset, key);
+        if (record == 0)
+        {
+            continue;
+        }
+
+        uint32_t header = *(const uint32_t *)(uintptr_t)record;
+        if (KV_HEADER_LEN(header) == KV_DELETED_LEN)
+        {
+            continue;
+        }
+
+        const uint8_t *p_value = (const uint8_t *)(uintptr_t)record + sizeof(uint32_t);
+        int            ret_val = KVStore_Append(target, &offset, key, p_value, KV_HEADER_LEN(header));
+        if (ret_val != KV_STORE_SUCCESS)
+        {
+            return ret_val;
+        }
+    }
+
+    // Header is written last, so interrupted compaction leaves previous sector active.
+    KVSectorHeader_T header = {KV_SECTOR_MAGIC, p_active->sequence + 1};
+    if (Flasher_SaveMemoryToEeprom(target, (uint32_t *)&header, sizeof(header) / sizeof(uint32_t)) != FLASHER_SUCCESS)
+    {
+        return KV_STORE_ERROR_FLASH;
+    }
+
+    Flasher_EraseEepromSector(ActiveSector);
+
+    ActiveSector = target;
+    WriteOffset  = offset;
+
+    return KV_STORE_SUCCESS;
+}
@@ -24,6 +24,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <string.h>
 
 #include "Config.h"
+#include "KVStore.h"
 #include "LCD.h"
 #include "MCU_Attention.h"
 #include "MCU_DFU.h"
@@ -287,6 +288,7 @@ void ProcessFactoryResetEvent(void)
 void setup()
 {
     SetupDebug();
+    KVStore_Init();
 
     SetupAttention();
     LCD_Setup();
@@ -0,0 +1,51 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SCRATCH_H_
+#define SCRATCH_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ *  Get number of bytes which can be acquired from scratch arena
+ *
+ *  @return          Number of available bytes, 0 if arena is in use
+ */
+size_t Scratch_GetAvailable(void);
+
+/*
+ *  Acquire scratch arena. Arena has a single owner, it has to be released
+ *  before it can be acquired again.
+ *
+ *  @param size      Requested size
+ *  @return          Pointer to word aligned memory, NULL if arena is in use or not enough RAM is available
+ */
+uint8_t *Scratch_Acquire(size_t size);
+
+/*
+ *  Release scratch arena, memory is returned to the gap between heap and stack
+ */
+void Scratch_Release(void);
+
+#endif    // SCRATCH_H_
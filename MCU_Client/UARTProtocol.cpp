@@ -78,6 +78,10 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define UART_CMD_DFU_STATE_CHECK_RESP 0x8Au
 #define UART_CMD_DFU_CANCEL_REQ 0x8Bu
 #define UART_CMD_DFU_CANCEL_RESP 0x8Cu
+#define UART_CMD_DFU_WINDOW_WRITE_EVENT 0x8Du
+#define UART_CMD_DFU_WINDOW_ACK_EVENT 0x8Eu
+#define UART_CMD_DFU_STATS_REQ 0x8Fu
+#define UART_CMD_DFU_STATS_RESP 0x90u
 
 #define UART_CMD_DFU_OFFSET 0x80
 
@@ -240,6 +244,16 @@ void UART_SendDfuCancelRequest(uint8_t *p_payload, uint8_t len)
     UARTInternal_Send(len, UART_CMD_DFU_CANCEL_REQ, p_payload);
 }
 
+void UART_SendDfuWindowAckEvent(uint8_t *p_payload, uint8_t len)
+{
+    UARTInternal_Send(len, UART_CMD_DFU_WINDOW_ACK_EVENT, p_payload);
+}
+
+void UART_SendDfuStatsResponse(uint8_t *p_payload, uint8_t len)
+{
+    UARTInternal_Send(len, UART_CMD_DFU_STATS_RESP, p_payload);
+}
+
 void UART_SendFirmwareVersionSetRequest(uint8_t *p_payload, uint8_t len)
 {
     UARTInternal_Send(len, UART_CMD_FIRMWARE_VERSION_SET_REQ, p_payload);
@@ -338,6 +352,16 @@ void UART_ProcessIncomingCommand(void)
             ProcessDfuCancelResponse(rx_frame.p_payload, rx_frame.len);
             break;
         }
+        case UART_CMD_DFU_WINDOW_WRITE_EVENT:
+        {
+            ProcessDfuWindowWriteEvent(rx_frame.p_payload, rx_frame.len);
+            break;
+        }
+        case UART_CMD_DFU_STATS_REQ:
+        {
+            ProcessDfuStatsRequest(rx_frame.p_payload, rx_frame.len);
+            break;
+        }
         case UART_CMD_FACTORY_RESET_EVENT:
         {
             ProcessFactoryResetEvent();
@@ -497,7 +521,11 @@ static void PrintDebug(const char *dir, uint8_t len, uint8_t cmd, uint8_t *buf,
                                 "DfuStateCheckRequest",
                                 "DfuStateCheckResponse",
                                 "DfuCancelRequest",
-                                "DfuCancelResponse"};
+                                "DfuCancelResponse",
+                                "DfuWindowWriteEvent",
+                                "DfuWindowAckEvent",
+                                "DfuStatsRequest",
+                                "DfuStatsResponse"};
 
     const char unknown_command_name[] = "Unknown";
 
@@ -156,6 +156,22 @@ void UART_SendDfuStateCheckRequest(uint8_t *p_payload, uint8_t len);
  */
 void UART_SendDfuCancelRequest(uint8_t *p_payload, uint8_t len);
 
+/*
+ *  Send Dfu Window Ack Event command
+ *
+ *  @param * p_payload   Command payload
+ *  @param len           Payload len
+ */
+void UART_SendDfuWindowAckEvent(uint8_t *p_payload, uint8_t len);
+
+/*
+ *  Send Dfu Stats Response command
+ *
+ *  @param * p_payload   Command payload
+ *  @param len           Payload len
+ */
+void UART_SendDfuStatsResponse(uint8_t *p_payload, uint8_t len);
+
 /*
  *  Receive and process incoming UART command
  */
@@ -281,6 +297,22 @@ extern void ProcessDfuStateCheckResponse(uint8_t *p_payload, uint8_t len);
  */
 extern void ProcessDfuCancelResponse(uint8_t *p_payload, uint8_t len);
 
+/*
+ *  Process Dfu Window Write Event command
+ *
+ *  @param * p_payload   Command payload
+ *  @param len           Payload len
+ */
+extern void ProcessDfuWindowWriteEvent(uint8_t *p_payload, uint8_t len);
+
+/*
+ *  Process Dfu Stats Request command
+ *
+ *  @param * p_payload   Command payload
+ *  @param len           Payload len
+ */
+extern void ProcessDfuStatsRequest(uint8_t *p_payload, uint8_t len);
+
 /*
  *  Process FactoryResetEvent
  */
@@ -0,0 +1,189 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Config.h"
+
+#if ENABLE_ALS_DMA
+
+#include "AlsAdc.h"
+
+#include <DMAChannel.h>
+
+#include "kinetis.h"
+
+
+#define ADC_CHANNEL_DISABLED 0x1Fu  /**< ADCH value of disabled ADC, also used as ADCH mask */
+#define DMA_TRANSFER_COUNT 0x40000u /**< Samples written before DMA is restarted, byte counter is limited to 0xFFFFF */
+
+static_assert(ENABLE_PIRALS, "ADC sampling is used by ambient light sensor only");
+static_assert(!ENABLE_DMA_PWM, "UART and DMA playback already take all four DMA channels");
+static_assert(ALS_ADC_RING_SIZE == (1u << (2u * ALS_ADC_OVERSAMPLING_BITS)),
+              "Decimation gains one bit per four samples of ring");
+static_assert(ALS_ADC_MEDIAN_SIZE % 2u == 1u, "Median filter needs odd number of samples");
+
+
+static DMAChannel Dma;
+static bool       IsRunning                   = false;
+static uint32_t   Timestamp                   = 0;
+static uint32_t   Median[ALS_ADC_MEDIAN_SIZE] = {0}; /**< Last decimated samples */
+static size_t     MedianIndex                 = 0;
+static uint32_t   IirAccumulator              = 0; /**< Filtered value scaled by 2^ALS_ADC_IIR_SHIFT */
+
+/*
+ *  According to KL26 reference manual, DMA buffers must be aligned to a 0-modulo-(circular buffer size) boundary.
+ */
+static __attribute__((section(".dmabuffers"), aligned(sizeof(uint16_t) * ALS_ADC_RING_SIZE)))
+volatile uint16_t Ring[ALS_ADC_RING_SIZE];
+
+
+/*
+ *  Reset filters to value
+ *
+ *  @param sample    Decimated sample
+ */
+static void AlsAdc_ResetFilters(uint32_t sample);
+
+/*
+ *  Average ring buffer into one sample with ALS_ADC_OVERSAMPLING_BITS more bits
+ *
+ *  @return          Decimated sample
+ */
+static uint32_t AlsAdc_Decimate(void);
+
+/*
+ *  Add sample to median filter
+ *
+ *  @param sample    Decimated sample
+ *  @return          Median of last ALS_ADC_MEDIAN_SIZE samples
+ */
+static uint32_t AlsAdc_Median(uint32_t sample);
+
+/*
+ *  DMA transfer completion handler, restarts transfer into ring
+ */
+static void AlsAdc_OnCompletion(void);
+
+
+bool AlsAdc_Setup(uint8_t pin)
+{
+    // Let Teensyduino calibrate ADC and configure pin, then take over ADC
+    analogReadResolution(16);
+    analogReadAveraging(ALS_ADC_HW_AVERAGING);
+    uint16_t first_sample = analogRead(pin);
+
+    uint32_t channel = ADC0_SC1A & ADC_SC1_ADCH(ADC_CHANNEL_DISABLED);
+    if (channel == ADC_CHANNEL_DISABLED)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < ALS_ADC_RING_SIZE; i++)
+    {
+        Ring[i] = first_sample;
+    }
+    AlsAdc_ResetFilters((uint32_t)first_sample << ALS_ADC_OVERSAMPLING_BITS);
+
+    Dma.source((volatile uint16_t &)ADC0_RA);
+    Dma.destinationCircular(Ring, sizeof(Ring));
+    Dma.transferCount(DMA_TRANSFER_COUNT);
+    Dma.disableOnCompletion();
+    Dma.interruptAtCompletion();
+    Dma.attachInterrupt(AlsAdc_OnCompletion);
+    Dma.triggerAtHardwareEvent(DMAMUX_SOURCE_ADC0);
+    Dma.enable();
+
+    // Every completed conversion requests DMA, writing channel starts continuous conversion
+    ADC0_SC2 |= ADC_SC2_DMAEN;
+    ADC0_SC3 |= ADC_SC3_ADCO;
+    ADC0_SC1A = channel;
+
+    Timestamp = millis();
+    IsRunning = true;
+    return true;
+}
+
+void AlsAdc_Loop(void)
+{
+    if (!IsRunning || millis() - Timestamp < ALS_ADC_FILTER_INTERVAL_MS)
+        return;
+
+    Timestamp = millis();
+
+    uint32_t sample = AlsAdc_Median(AlsAdc_Decimate());
+    IirAccumulator += sample - (IirAccumulator >> ALS_ADC_IIR_SHIFT);
+}
+
+uint32_t AlsAdc_Read(void)
+{
+    return IirAccumulator >> ALS_ADC_IIR_SHIFT;
+}
+
+
+static void AlsAdc_ResetFilters(uint32_t sample)
+{
+    for (size_t i = 0; i < ALS_ADC_MEDIAN_SIZE; i++)
+    {
+        Median[i] = sample;
+    }
+    MedianIndex    = 0;
+    IirAccumulator = sample << ALS_ADC_IIR_SHIFT;
+}
+
+static uint32_t AlsAdc_Decimate(void)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < ALS_ADC_RING_SIZE; i++)
+    {
+        sum += Ring[i];
+    }
+
+    return sum >> ALS_ADC_OVERSAMPLING_BITS;
+}
+
+static uint32_t AlsAdc_Median(uint32_t sample)
+{
+    Median[MedianIndex] = sample;
+    MedianIndex         = (MedianIndex + 1) % ALS_ADC_MEDIAN_SIZE;
+
+    // Insertion sort, window is a few samples long
+    uint32_t sorted[ALS_ADC_MEDIAN_SIZE];
+    for (size_t i = 0; i < ALS_ADC_MEDIAN_SIZE; i++)
+    {
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > Median[i]; j--)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = Median[i];
+    }
+
+    return sorted[ALS_ADC_MEDIAN_SIZE / 2];
+}
+
+static void AlsAdc_OnCompletion(void)
+{
+    Dma.clearInterrupt();
+    Dma.transferCount(DMA_TRANSFER_COUNT);
+    Dma.enable();
+}
+
+#endif
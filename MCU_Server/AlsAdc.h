@@ -0,0 +1,64 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALS_ADC_H_
+#define ALS_ADC_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define ALS_ADC_HW_AVERAGING 32u     /**< Conversions averaged by ADC hardware into one sample */
+#define ALS_ADC_RING_SIZE 64u        /**< Samples written by DMA into ring, power of two */
+#define ALS_ADC_OVERSAMPLING_BITS 3u /**< Bits gained by decimating the ring, log4(ALS_ADC_RING_SIZE) */
+
+#define ALS_ADC_RESOLUTION_BITS (16u + ALS_ADC_OVERSAMPLING_BITS) /**< Resolution of filtered value */
+#define ALS_ADC_MAX ((1ul << ALS_ADC_RESOLUTION_BITS) - 1)         /**< Maximum filtered value */
+
+#define ALS_ADC_FILTER_INTERVAL_MS 20u /**< Period of decimation and filtering */
+#define ALS_ADC_MEDIAN_SIZE 5u         /**< Decimated samples in median filter, odd, 1 disables the filter */
+#define ALS_ADC_IIR_SHIFT 2u           /**< IIR filter coefficient is 1 / 2^n, 0 disables the filter */
+
+
+/*
+ *  Setup ADC in continuous conversion mode with DMA writing samples of pin into ring buffer.
+ *  Takes over ADC0, analogRead must not be used afterwards.
+ *
+ *  @param pin       Analog pin
+ *  @return          True if success, false if pin is not analog
+ */
+bool AlsAdc_Setup(uint8_t pin);
+
+/*
+ *  Decimate ring buffer and update median and IIR filters every ALS_ADC_FILTER_INTERVAL_MS.
+ *  Should be called in every loop iteration.
+ */
+void AlsAdc_Loop(void);
+
+/*
+ *  Get filtered value. Does not block.
+ *
+ *  @return          Filtered value (0 - ALS_ADC_MAX)
+ */
+uint32_t AlsAdc_Read(void);
+
+#endif    // ALS_ADC_H_
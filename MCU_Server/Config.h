@@ -26,11 +26,20 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Arduino.h"
 
 
-#define ENABLE_LC 1     /**< Enable LC support */
-#define ENABLE_CTL 0    /**< Enable CTL support */
-#define ENABLE_PIRALS 1 /**< Enable PIR and ALS support */
-#define ENABLE_ENERGY 1 /**< Enable energy monitoring support */
-#define ENABLE_1_10_V 0 /**< Define for calculate lightness for 0-10 V (value 0) or 1-10 V (value 1) */
+#define ENABLE_LC 1                  /**< Enable LC support */
+#define ENABLE_CTL 0                 /**< Enable CTL support */
+#define ENABLE_PIRALS 1              /**< Enable PIR and ALS support */
+#define ENABLE_ENERGY 1              /**< Enable energy monitoring support */
+#define ENABLE_1_10_V 0              /**< Define for calculate lightness for 0-10 V (value 0) or 1-10 V (value 1) */
+#define ENABLE_DITHERING 0           /**< Enable temporal dithering of PWM output at low lightness, dimming timer runs while it dithers */
+#define ENABLE_DMA_PWM 0             /**< Play PWM duty of transitions with DMA instead of dimming interrupt */
+#define ENABLE_OUTPUT_CALIBRATION 0  /**< Convert warm and cold output with calibration table of each LED string */
+#define ENABLE_LOCAL_OCCUPANCY 0     /**< Fade up lightness on local PIR trigger before mesh Light LC Server responds */
+#define ENABLE_DAYLIGHT_HARVESTING 0 /**< Dim lightness with local PI controller holding ambient light setpoint */
+#define ENABLE_ALS_DMA 0             /**< Sample ambient light sensor continuously with DMA, decimate and filter samples */
+#define ENABLE_MESH_DELAY 0          /**< Start transitions after Delay field, needs modem firmware appending Delay to status messages */
+
+#define TRANSITION_PROFILE TRANSITION_PROFILE_LINEAR /**< Profile of transitions set by mesh: LINEAR, EASE_IN_OUT or PERCEPTUAL */
 
 #define BUILD_NUMBER "0000"            /**< Defines firmware build number. */
 #define DFU_VALIDATION_STRING "server" /**< Defines string to be expected in app data */
@@ -60,6 +69,10 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define PIN_ENCODER_B 4   /**< Defines encoder B pin. */
 #define PIN_ANALOG 9      /**< Defines analog measurement pin. */
 
+#define LIGHTNESS_CHANNELS 1               /**< Defines number of independently dimmed luminaires. */
+#define LIGHTNESS_PINS_WARM {PIN_PWM_WARM} /**< Defines warm pwm pin of each luminaire. */
+#define LIGHTNESS_PINS_COLD {PIN_PWM_COLD} /**< Defines cold pwm pin of each luminaire. */
+
 #define BUTTON_DEBOUNCE_TIME_MS 20 /**< Defines buttons debounce time in milliseconds. */
 
 #if ENABLE_PIRALS == 1
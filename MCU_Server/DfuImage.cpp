@@ -0,0 +1,542 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "DfuImage.h"
+
+#include <string.h>
+
+#include "Flasher.h"
+
+
+#define OUTPUT_BUFFER_SIZE 256u     /**< Decoded data buffer size, multiple of word size */
+#define ERASED_BYTE_VAL 0xFFu       /**< Value used to pad last decoded word */
+#define LZ4_MIN_MATCH_LEN 4u        /**< LZ4 minimal match length */
+#define LZ4_LEN_MASK 0x0Fu          /**< LZ4 token length mask */
+#define LZ4_LEN_EXTENDED 0x0Fu      /**< LZ4 token length value which is followed by length bytes */
+#define LZ4_LEN_BYTE_CONTINUE 0xFFu /**< LZ4 length byte value which is followed by another length byte */
+#define DELTA_OP_INSERT 0x00u       /**< Delta operation: length (2), data bytes follow */
+#define DELTA_OP_COPY 0x01u         /**< Delta operation: source offset (3), length (2) */
+#define DELTA_INSERT_ARGS_LEN 2u    /**< Delta insert operation arguments length */
+#define DELTA_COPY_ARGS_LEN 5u      /**< Delta copy operation arguments length */
+#define DELTA_MAX_ARGS_LEN DELTA_COPY_ARGS_LEN
+
+
+typedef enum
+{
+    IMAGE_STATE_HEADER,
+    IMAGE_STATE_RAW,
+    IMAGE_STATE_LZ4_TOKEN,
+    IMAGE_STATE_LZ4_LITERAL_LEN,
+    IMAGE_STATE_LZ4_LITERALS,
+    IMAGE_STATE_LZ4_OFFSET_LO,
+    IMAGE_STATE_LZ4_OFFSET_HI,
+    IMAGE_STATE_LZ4_MATCH_LEN,
+    IMAGE_STATE_DELTA_OP,
+    IMAGE_STATE_DELTA_ARGS,
+    IMAGE_STATE_DELTA_INSERT,
+    IMAGE_STATE_ERROR,
+} ImageState_T;
+
+
+static ImageState_T State       = IMAGE_STATE_HEADER;
+static size_t       ImageSize   = 0; /**< Expected decoded image size */
+static size_t       OutFlushed  = 0; /**< Number of decoded bytes saved in flash */
+static size_t       OutFill     = 0; /**< Number of decoded bytes waiting in OutBuffer */
+static uint8_t      Token       = 0;
+static size_t       Remaining   = 0;
+static size_t       MatchOffset = 0;
+static uint8_t      DeltaOp     = 0;
+static uint8_t      ArgsLen     = 0;
+static uint8_t      Args[DELTA_MAX_ARGS_LEN];
+static uint8_t      OutBuffer[OUTPUT_BUFFER_SIZE] __attribute__((aligned(4)));
+
+
+/*
+ *  Parse encoded image header
+ *
+ *  @param p_data    Pointer to first page of image
+ *  @param len       Page length
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_ParseHeader(const uint8_t *p_data, size_t len);
+
+/*
+ *  Feed LZ4 block data to decoder
+ *
+ *  @param p_data    Pointer to data
+ *  @param len       Data length
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_DecodeLZ4(const uint8_t *p_data, size_t len);
+
+/*
+ *  Feed delta data to decoder
+ *
+ *  @param p_data    Pointer to data
+ *  @param len       Data length
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_DecodeDelta(const uint8_t *p_data, size_t len);
+
+/*
+ *  Execute delta operation once its arguments are received
+ *
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_ExecuteDeltaOp(void);
+
+/*
+ *  Copy match from already decoded data
+ *
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_CopyMatch(void);
+
+/*
+ *  Append byte to decoded image
+ *
+ *  @param byte      Decoded byte
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_Emit(uint8_t byte);
+
+/*
+ *  Read byte of already decoded image
+ *
+ *  @param offset    Offset in decoded image
+ *  @return          Decoded byte
+ */
+static uint8_t DfuImage_ReadDecoded(size_t offset);
+
+/*
+ *  Save buffered decoded data to flash
+ *
+ *  @return          DFU image decoder return code
+ */
+static int DfuImage_Flush(void);
+
+/*
+ *  Read little endian word
+ *
+ *  @param p_data    Pointer to data
+ *  @return          Word value
+ */
+static uint32_t DfuImage_ReadWord(const uint8_t *p_data);
+
+
+void DfuImage_Init(void)
+{
+    State       = IMAGE_STATE_HEADER;
+    ImageSize   = 0;
+    OutFlushed  = 0;
+    OutFill     = 0;
+    Token       = 0;
+    Remaining   = 0;
+    MatchOffset = 0;
+    DeltaOp     = 0;
+    ArgsLen     = 0;
+}
+
+void DfuImage_Resume(size_t offset)
+{
+    DfuImage_Init();
+    State      = IMAGE_STATE_RAW;
+    OutFlushed = offset;
+}
+
+bool DfuImage_IsEncoded(void)
+{
+    return State != IMAGE_STATE_HEADER && State != IMAGE_STATE_RAW;
+}
+
+int DfuImage_Write(const uint8_t *p_data, size_t len)
+{
+    if (State == IMAGE_STATE_HEADER)
+    {
+        if (len < sizeof(uint32_t) || DfuImage_ReadWord(p_data) != DFU_IMAGE_MAGIC)
+        {
+            State = IMAGE_STATE_RAW;
+        }
+        else
+        {
+            int ret_val = DfuImage_ParseHeader(p_data, len);
+            if (ret_val != DFU_IMAGE_SUCCESS)
+            {
+                State = IMAGE_STATE_ERROR;
+                return ret_val;
+            }
+
+            p_data += DFU_IMAGE_HEADER_LEN;
+            len -= DFU_IMAGE_HEADER_LEN;
+        }
+    }
+
+    switch (State)
+    {
+        case IMAGE_STATE_RAW:
+        {
+            uint32_t address = Flasher_GetSpaceAddr() + OutFlushed;
+            if (Flasher_SaveMemoryToFlash(address, (const uint32_t *)p_data, len / 4) != FLASHER_SUCCESS)
+            {
+                return DFU_IMAGE_ERROR_FLASH;
+            }
+            OutFlushed += len;
+            return DFU_IMAGE_SUCCESS;
+        }
+        case IMAGE_STATE_ERROR:
+        {
+            return DFU_IMAGE_ERROR_FORMAT;
+        }
+        default:
+        {
+            int ret_val;
+            if (State >= IMAGE_STATE_DELTA_OP)
+                ret_val = DfuImage_DecodeDelta(p_data, len);
+            else
+                ret_val = DfuImage_DecodeLZ4(p_data, len);
+
+            if (ret_val != DFU_IMAGE_SUCCESS)
+            {
+                State = IMAGE_STATE_ERROR;
+            }
+            return ret_val;
+        }
+    }
+}
+
+int DfuImage_Finish(void)
+{
+    switch (State)
+    {
+        case IMAGE_STATE_RAW:
+        {
+            return DFU_IMAGE_SUCCESS;
+        }
+        case IMAGE_STATE_LZ4_TOKEN:
+        case IMAGE_STATE_LZ4_OFFSET_LO:
+        case IMAGE_STATE_DELTA_OP:
+        {
+            if (OutFlushed + OutFill != ImageSize)
+            {
+                return DFU_IMAGE_ERROR_FORMAT;
+            }
+            return DfuImage_Flush();
+        }
+        default:
+        {
+            return DFU_IMAGE_ERROR_FORMAT;
+        }
+    }
+}
+
+size_t DfuImage_GetSize(void)
+{
+    return OutFlushed + OutFill;
+}
+
+
+static int DfuImage_ParseHeader(const uint8_t *p_data, size_t len)
+{
+    if (len < DFU_IMAGE_HEADER_LEN)
+    {
+        return DFU_IMAGE_ERROR_FORMAT;
+    }
+
+    size_t  index  = sizeof(uint32_t);
+    uint8_t format = p_data[index];
+    index += sizeof(uint32_t);
+    ImageSize = DfuImage_ReadWord(p_data + index);
+
+    if (ImageSize >= Flasher_GetSpaceSize())
+    {
+        return DFU_IMAGE_ERROR_SIZE;
+    }
+
+    switch (format)
+    {
+        case DFU_IMAGE_FORMAT_LZ4:
+        {
+            State = IMAGE_STATE_LZ4_TOKEN;
+            return DFU_IMAGE_SUCCESS;
+        }
+        case DFU_IMAGE_FORMAT_DELTA:
+        {
+            State = IMAGE_STATE_DELTA_OP;
+            return DFU_IMAGE_SUCCESS;
+        }
+        default:
+        {
+            return DFU_IMAGE_ERROR_FORMAT;
+        }
+    }
+}
+
+static int DfuImage_DecodeLZ4(const uint8_t *p_data, size_t len)
+{
+    size_t index = 0;
+
+    while (index < len)
+    {
+        switch (State)
+        {
+            case IMAGE_STATE_LZ4_TOKEN:
+            {
+                Token     = p_data[index++];
+                Remaining = Token >> 4;
+
+                if (Remaining == LZ4_LEN_EXTENDED)
+                    State = IMAGE_STATE_LZ4_LITERAL_LEN;
+                else if (Remaining != 0)
+                    State = IMAGE_STATE_LZ4_LITERALS;
+                else
+                    State = IMAGE_STATE_LZ4_OFFSET_LO;
+                break;
+            }
+            case IMAGE_STATE_LZ4_LITERAL_LEN:
+            {
+                uint8_t len_byte = p_data[index++];
+                Remaining += len_byte;
+
+                if (len_byte != LZ4_LEN_BYTE_CONTINUE)
+                    State = IMAGE_STATE_LZ4_LITERALS;
+                break;
+            }
+            case IMAGE_STATE_LZ4_LITERALS:
+            {
+                while (Remaining != 0 && index < len)
+                {
+                    int ret_val = DfuImage_Emit(p_data[index++]);
+                    if (ret_val != DFU_IMAGE_SUCCESS)
+                        return ret_val;
+                    Remaining--;
+                }
+
+                if (Remaining == 0)
+                    State = IMAGE_STATE_LZ4_OFFSET_LO;
+                break;
+            }
+            case IMAGE_STATE_LZ4_OFFSET_LO:
+            {
+                // Last sequence contains literals only, nothing is expected after it.
+                if (OutFlushed + OutFill == ImageSize)
+                    return DFU_IMAGE_ERROR_FORMAT;
+
+                MatchOffset = p_data[index++];
+                State       = IMAGE_STATE_LZ4_OFFSET_HI;
+                break;
+            }
+            case IMAGE_STATE_LZ4_OFFSET_HI:
+            {
+                MatchOffset |= ((size_t)p_data[index++] << 8);
+                if (MatchOffset == 0 || MatchOffset > OutFlushed + OutFill)
+                    return DFU_IMAGE_ERROR_FORMAT;
+
+                Remaining = (Token & LZ4_LEN_MASK) + LZ4_MIN_MATCH_LEN;
+                if ((Token & LZ4_LEN_MASK) == LZ4_LEN_EXTENDED)
+                {
+                    State = IMAGE_STATE_LZ4_MATCH_LEN;
+                    break;
+                }
+
+                int ret_val = DfuImage_CopyMatch();
+                if (ret_val != DFU_IMAGE_SUCCESS)
+                    return ret_val;
+                State = IMAGE_STATE_LZ4_TOKEN;
+                break;
+            }
+            case IMAGE_STATE_LZ4_MATCH_LEN:
+            {
+                uint8_t len_byte = p_data[index++];
+                Remaining += len_byte;
+
+                if (len_byte != LZ4_LEN_BYTE_CONTINUE)
+                {
+                    int ret_val = DfuImage_CopyMatch();
+                    if (ret_val != DFU_IMAGE_SUCCESS)
+                        return ret_val;
+                    State = IMAGE_STATE_LZ4_TOKEN;
+                }
+                break;
+            }
+            default:
+            {
+                return DFU_IMAGE_ERROR_FORMAT;
+            }
+        }
+    }
+
+    return DFU_IMAGE_SUCCESS;
+}
+
+static int DfuImage_DecodeDelta(const uint8_t *p_data, size_t len)
+{
+    size_t index = 0;
+
+    while (index < len)
+    {
+        switch (State)
+        {
+            case IMAGE_STATE_DELTA_OP:
+            {
+                DeltaOp = p_data[index++];
+                ArgsLen = 0;
+                if (DeltaOp != DELTA_OP_INSERT && DeltaOp != DELTA_OP_COPY)
+                    return DFU_IMAGE_ERROR_FORMAT;
+
+                State = IMAGE_STATE_DELTA_ARGS;
+                break;
+            }
+            case IMAGE_STATE_DELTA_ARGS:
+            {
+                Args[ArgsLen++] = p_data[index++];
+
+                size_t args_len = (DeltaOp == DELTA_OP_COPY) ? DELTA_COPY_ARGS_LEN : DELTA_INSERT_ARGS_LEN;
+                if (ArgsLen == args_len)
+                {
+                    int ret_val = DfuImage_ExecuteDeltaOp();
+                    if (ret_val != DFU_IMAGE_SUCCESS)
+                        return ret_val;
+                }
+                break;
+            }
+            case IMAGE_STATE_DELTA_INSERT:
+            {
+                while (Remaining != 0 && index < len)
+                {
+                    int ret_val = DfuImage_Emit(p_data[index++]);
+                    if (ret_val != DFU_IMAGE_SUCCESS)
+                        return ret_val;
+                    Remaining--;
+                }
+
+                if (Remaining == 0)
+                    State = IMAGE_STATE_DELTA_OP;
+                break;
+            }
+            default:
+            {
+                return DFU_IMAGE_ERROR_FORMAT;
+            }
+        }
+    }
+
+    return DFU_IMAGE_SUCCESS;
+}
+
+static int DfuImage_ExecuteDeltaOp(void)
+{
+    if (DeltaOp == DELTA_OP_INSERT)
+    {
+        Remaining = ((size_t)Args[0]) | ((size_t)Args[1] << 8);
+        State     = (Remaining != 0) ? IMAGE_STATE_DELTA_INSERT : IMAGE_STATE_DELTA_OP;
+        return DFU_IMAGE_SUCCESS;
+    }
+
+    size_t source = ((size_t)Args[0]) | ((size_t)Args[1] << 8) | ((size_t)Args[2] << 16);
+    size_t length = ((size_t)Args[3]) | ((size_t)Args[4] << 8);
+
+    // Source is offset in the running firmware, which ends before DFU space.
+    if (source + length > Flasher_GetSpaceAddr() - FLASH_BASE_ADDR)
+        return DFU_IMAGE_ERROR_FORMAT;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        int ret_val = DfuImage_Emit(*(const volatile uint8_t *)(FLASH_BASE_ADDR + source + i));
+        if (ret_val != DFU_IMAGE_SUCCESS)
+            return ret_val;
+    }
+
+    State = IMAGE_STATE_DELTA_OP;
+    return DFU_IMAGE_SUCCESS;
+}
+
+static int DfuImage_CopyMatch(void)
+{
+    for (; Remaining != 0; Remaining--)
+    {
+        int ret_val = DfuImage_Emit(DfuImage_ReadDecoded(OutFlushed + OutFill - MatchOffset));
+        if (ret_val != DFU_IMAGE_SUCCESS)
+            return ret_val;
+    }
+
+    return DFU_IMAGE_SUCCESS;
+}
+
+static int DfuImage_Emit(uint8_t byte)
+{
+    if (OutFlushed + OutFill >= ImageSize)
+    {
+        return DFU_IMAGE_ERROR_FORMAT;
+    }
+
+    OutBuffer[OutFill++] = byte;
+
+    if (OutFill == OUTPUT_BUFFER_SIZE)
+    {
+        return DfuImage_Flush();
+    }
+
+    return DFU_IMAGE_SUCCESS;
+}
+
+static uint8_t DfuImage_ReadDecoded(size_t offset)
+{
+    if (offset >= OutFlushed)
+    {
+        return OutBuffer[offset - OutFlushed];
+    }
+
+    // Decoded data is already in flash, so match offset is not limited by RAM window.
+    return *(const volatile uint8_t *)(Flasher_GetSpaceAddr() + offset);
+}
+
+static int DfuImage_Flush(void)
+{
+    if (OutFill == 0)
+    {
+        return DFU_IMAGE_SUCCESS;
+    }
+
+    size_t words = (OutFill + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    memset(OutBuffer + OutFill, ERASED_BYTE_VAL, words * sizeof(uint32_t) - OutFill);
+
+    uint32_t address = Flasher_GetSpaceAddr() + OutFlushed;
+    if (Flasher_SaveMemoryToFlash(address, (const uint32_t *)OutBuffer, words) != FLASHER_SUCCESS)
+    {
+        return DFU_IMAGE_ERROR_FLASH;
+    }
+
+    OutFlushed += OutFill;
+    OutFill = 0;
+
+    return DFU_IMAGE_SUCCESS;
+}
+
+static uint32_t DfuImage_ReadWord(const uint8_t *p_data)
+{
+    uint32_t word;
+    word = ((uint32_t)p_data[0]);
+    word |= ((uint32_t)p_data[1] << 8);
+    word |= ((uint32_t)p_data[2] << 16);
+    word |= ((uint32_t)p_data[3] << 24);
+    return word;
+}
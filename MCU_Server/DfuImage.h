@@ -0,0 +1,88 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DFU_IMAGE_H_
+#define DFU_IMAGE_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**< DFU image decoder return codes */
+#define DFU_IMAGE_SUCCESS 0
+#define DFU_IMAGE_ERROR_FORMAT 1
+#define DFU_IMAGE_ERROR_SIZE 2
+#define DFU_IMAGE_ERROR_FLASH 3
+
+/**< Encoded DFU image header description */
+#define DFU_IMAGE_MAGIC 0x55464453u  /**< "SDFU" in little endian */
+#define DFU_IMAGE_HEADER_LEN 12u     /**< Magic (4), format (1), reserved (3), decoded image size (4) */
+#define DFU_IMAGE_FORMAT_LZ4 0x01u   /**< Image stream is a LZ4 block */
+#define DFU_IMAGE_FORMAT_DELTA 0x02u /**< Image stream is a delta against running firmware */
+
+
+/*
+ *  Reset image decoder. Should be called before first page of new image is written.
+ */
+void DfuImage_Init(void);
+
+/*
+ *  Continue not encoded image which is already partially saved in DFU space.
+ *
+ *  @param offset    Number of bytes already saved
+ */
+void DfuImage_Resume(size_t offset);
+
+/*
+ *  Check if image is encoded. Valid after first page of image is written.
+ *
+ *  @return          True if image starts with DFU image header or decoder is in error state, false otherwise
+ */
+bool DfuImage_IsEncoded(void);
+
+/*
+ *  Decode next part of transferred image and save decoded data to DFU space.
+ *  Images not starting with DFU image header are saved as they are.
+ *  Any error of encoded image, including flash error, latches decoder in error state until DfuImage_Init,
+ *  because the data has already been consumed and can't be decoded again.
+ *
+ *  @param p_data    Pointer to received data
+ *  @param len       Data length
+ *  @return          DFU image decoder return code
+ */
+int DfuImage_Write(const uint8_t *p_data, size_t len);
+
+/*
+ *  Finish image decoding, flush buffered data to DFU space.
+ *
+ *  @return          DFU image decoder return code
+ */
+int DfuImage_Finish(void);
+
+/*
+ *  Get number of decoded bytes saved in DFU space.
+ *
+ *  @return          Decoded image size
+ */
+size_t DfuImage_GetSize(void);
+
+#endif    // DFU_IMAGE_H_
@@ -0,0 +1,277 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Config.h"
+
+#if ENABLE_DMA_PWM
+
+#include "DmaPwm.h"
+
+#include <DMAChannel.h>
+
+#include "kinetis.h"
+
+
+#define NO_HALF 0xFFu /**< No playback buffer half selected */
+
+#ifndef TPM_SC_DMA
+#define TPM_SC_DMA 0x100u /**< DMA request on timer overflow enable */
+#endif
+
+
+/*
+ *  Timer channel connected to PWM pin
+ */
+typedef struct
+{
+    uint8_t            pin;
+    uint8_t            dma_source;
+    volatile uint32_t *p_cnv;
+    volatile uint32_t *p_mod;
+    volatile uint32_t *p_sc;
+    volatile uint32_t *p_cnt;
+} DmaPwmPin_T;
+
+
+static const DmaPwmPin_T Pins[] = {
+    {3, DMAMUX_SOURCE_TPM2_OV, &TPM2_C0V, &TPM2_MOD, &TPM2_SC, &TPM2_CNT},
+    {4, DMAMUX_SOURCE_TPM2_OV, &TPM2_C1V, &TPM2_MOD, &TPM2_SC, &TPM2_CNT},
+    {6, DMAMUX_SOURCE_TPM0_OV, &TPM0_C4V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+    {9, DMAMUX_SOURCE_TPM0_OV, &TPM0_C2V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+    {10, DMAMUX_SOURCE_TPM0_OV, &TPM0_C3V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+    {16, DMAMUX_SOURCE_TPM1_OV, &TPM1_C0V, &TPM1_MOD, &TPM1_SC, &TPM1_CNT},
+    {17, DMAMUX_SOURCE_TPM1_OV, &TPM1_C1V, &TPM1_MOD, &TPM1_SC, &TPM1_CNT},
+    {20, DMAMUX_SOURCE_TPM0_OV, &TPM0_C5V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+    {22, DMAMUX_SOURCE_TPM0_OV, &TPM0_C0V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+    {23, DMAMUX_SOURCE_TPM0_OV, &TPM0_C1V, &TPM0_MOD, &TPM0_SC, &TPM0_CNT},
+};
+
+static DMAChannel    Dma[DMA_PWM_CHANNELS];
+static DmaPwm_Fill_T Fill                         = NULL;
+static uint32_t      Modulo[DMA_PWM_CHANNELS]     = {0};       /**< Timer counts per PWM period */
+static uint8_t       ActiveHalf[DMA_PWM_CHANNELS] = {0};       /**< Buffer half played by channel */
+static uint8_t       Completed[2]                 = {0};       /**< Number of channels which finished buffer half */
+static uint8_t       StopHalf                     = NO_HALF;   /**< Last buffer half to play */
+static volatile bool IsRunning                    = false;
+static volatile bool IsRestartRequested           = false;
+static uint32_t      Buffers[2][DMA_PWM_CHANNELS][DMA_PWM_PERIODS] __attribute__((aligned(4)));
+
+
+/*
+ *  Find timer channel connected to pin
+ *
+ *  @param pin       Pin number
+ *  @return          Pointer to timer channel, NULL if pin is not supported
+ */
+static const DmaPwmPin_T *DmaPwm_FindPin(uint8_t pin);
+
+/*
+ *  Fill half of playback buffer and convert duty to timer compare values
+ *
+ *  @param half      Buffer half
+ */
+static void DmaPwm_FillHalf(uint8_t half);
+
+/*
+ *  Start DMA transfer of active buffer half
+ *
+ *  @param channel   DMA PWM channel
+ */
+static void DmaPwm_PlayHalf(size_t channel);
+
+/*
+ *  Fill both buffer halves and start playback from first half. Should be called with interrupts disabled.
+ */
+static void DmaPwm_Restart(void);
+
+/*
+ *  DMA transfer completion handler
+ *
+ *  @param channel   DMA PWM channel
+ */
+static void DmaPwm_OnCompletion(size_t channel);
+
+static void DmaPwm_OnWarmCompletion(void);
+static void DmaPwm_OnColdCompletion(void);
+
+
+bool DmaPwm_Setup(uint8_t pin_warm, uint8_t pin_cold, DmaPwm_Fill_T fill)
+{
+    const DmaPwmPin_T *p_pins[DMA_PWM_CHANNELS];
+    p_pins[DMA_PWM_CHANNEL_WARM] = DmaPwm_FindPin(pin_warm);
+    p_pins[DMA_PWM_CHANNEL_COLD] = DmaPwm_FindPin(pin_cold);
+
+    if (p_pins[DMA_PWM_CHANNEL_WARM] == NULL || p_pins[DMA_PWM_CHANNEL_COLD] == NULL)
+    {
+        return false;
+    }
+
+    Fill = fill;
+
+    for (size_t channel = 0; channel < DMA_PWM_CHANNELS; channel++)
+    {
+        const DmaPwmPin_T *p_pin = p_pins[channel];
+
+        // Let Teensyduino select timer clock and configure pin, then take over compare register
+        analogWriteFrequency(p_pin->pin, DMA_PWM_FREQUENCY_HZ);
+        analogWrite(p_pin->pin, 0);
+        Modulo[channel] = *p_pin->p_mod + 1;
+        *p_pin->p_sc |= TPM_SC_DMA;
+
+        Dma[channel].destination(*p_pin->p_cnv);
+        Dma[channel].disableOnCompletion();
+        Dma[channel].interruptAtCompletion();
+        Dma[channel].triggerAtHardwareEvent(p_pin->dma_source);
+    }
+
+    Dma[DMA_PWM_CHANNEL_WARM].attachInterrupt(DmaPwm_OnWarmCompletion);
+    Dma[DMA_PWM_CHANNEL_COLD].attachInterrupt(DmaPwm_OnColdCompletion);
+
+    // Timers run from the same clock, resetting them together keeps both channels in phase
+    noInterrupts();
+    *p_pins[DMA_PWM_CHANNEL_WARM]->p_cnt = 0;
+    *p_pins[DMA_PWM_CHANNEL_COLD]->p_cnt = 0;
+    interrupts();
+
+    return true;
+}
+
+void DmaPwm_Start(void)
+{
+    noInterrupts();
+    if (!IsRunning)
+    {
+        DmaPwm_Restart();
+    }
+    else if (StopHalf != NO_HALF)
+    {
+        // Last half is already queued, start again once it is played
+        IsRestartRequested = true;
+    }
+    interrupts();
+}
+
+
+static const DmaPwmPin_T *DmaPwm_FindPin(uint8_t pin)
+{
+    for (size_t i = 0; i < sizeof(Pins) / sizeof(Pins[0]); i++)
+    {
+        if (Pins[i].pin == pin)
+        {
+            return &Pins[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void DmaPwm_FillHalf(uint8_t half)
+{
+    if (!Fill(Buffers[half]))
+    {
+        StopHalf = half;
+    }
+
+    for (size_t channel = 0; channel < DMA_PWM_CHANNELS; channel++)
+    {
+        for (size_t period = 0; period < DMA_PWM_PERIODS; period++)
+        {
+            Buffers[half][channel][period] = (Buffers[half][channel][period] * Modulo[channel]) >> 16;
+        }
+    }
+}
+
+static void DmaPwm_PlayHalf(size_t channel)
+{
+    Dma[channel].sourceBuffer(Buffers[ActiveHalf[channel]][channel], sizeof(Buffers[0][0]));
+    Dma[channel].enable();
+}
+
+static void DmaPwm_Restart(void)
+{
+    IsRunning          = true;
+    IsRestartRequested = false;
+    StopHalf           = NO_HALF;
+    Completed[0]       = 0;
+    Completed[1]       = 0;
+
+    DmaPwm_FillHalf(0);
+    if (StopHalf == NO_HALF)
+    {
+        DmaPwm_FillHalf(1);
+    }
+
+    for (size_t channel = 0; channel < DMA_PWM_CHANNELS; channel++)
+    {
+        ActiveHalf[channel] = 0;
+        DmaPwm_PlayHalf(channel);
+    }
+}
+
+static void DmaPwm_OnCompletion(size_t channel)
+{
+    Dma[channel].clearInterrupt();
+
+    uint8_t finished   = ActiveHalf[channel];
+    bool    is_last    = (finished == StopHalf);
+    bool    is_released = (++Completed[finished] == DMA_PWM_CHANNELS);
+
+    if (is_released)
+    {
+        Completed[finished] = 0;
+    }
+
+    if (is_last)
+    {
+        // Timer keeps the last compare value, output stays steady without DMA
+        if (is_released)
+        {
+            IsRunning = false;
+            if (IsRestartRequested)
+            {
+                DmaPwm_Restart();
+            }
+        }
+        return;
+    }
+
+    ActiveHalf[channel] = finished ^ 1;
+    DmaPwm_PlayHalf(channel);
+
+    // Half is refilled only when all channels left it, channels may be shifted by a part of period
+    if (is_released && StopHalf == NO_HALF)
+    {
+        DmaPwm_FillHalf(finished);
+    }
+}
+
+static void DmaPwm_OnWarmCompletion(void)
+{
+    DmaPwm_OnCompletion(DMA_PWM_CHANNEL_WARM);
+}
+
+static void DmaPwm_OnColdCompletion(void)
+{
+    DmaPwm_OnCompletion(DMA_PWM_CHANNEL_COLD);
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DMA_PWM_H_
+#define DMA_PWM_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define DMA_PWM_FREQUENCY_HZ 1600u /**< PWM frequency used for DMA playback */
+#define DMA_PWM_PERIODS 32u        /**< Number of PWM periods in one half of playback buffer */
+
+/**< DMA PWM channels */
+#define DMA_PWM_CHANNEL_WARM 0u
+#define DMA_PWM_CHANNEL_COLD 1u
+#define DMA_PWM_CHANNELS 2u
+
+
+/*
+ *  Fill half of playback buffer with PWM duty of next DMA_PWM_PERIODS periods. Called from DMA interrupt.
+ *
+ *  @param p_duty    [out] Duty (0 - UINT16_MAX) per channel and period
+ *  @return          False if this is the last half to play, output stays at its last duty afterwards
+ */
+typedef bool (*DmaPwm_Fill_T)(uint32_t p_duty[DMA_PWM_CHANNELS][DMA_PWM_PERIODS]);
+
+
+/*
+ *  Setup timers of PWM pins and DMA channels which write compare values on every timer overflow.
+ *  Both pins have to be PWM capable. Timers used by both pins run at DMA_PWM_FREQUENCY_HZ afterwards.
+ *
+ *  @param pin_warm  Warm channel pin
+ *  @param pin_cold  Cold channel pin
+ *  @param fill      Callback filling playback buffer
+ *  @return          True if success, false if any of pins is not supported
+ */
+bool DmaPwm_Setup(uint8_t pin_warm, uint8_t pin_cold, DmaPwm_Fill_T fill);
+
+/*
+ *  Start playback if it is stopped. Both halves of playback buffer are filled before it starts.
+ */
+void DmaPwm_Start(void);
+
+#endif    // DMA_PWM_H_
@@ -0,0 +1,136 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifdef __MKL26Z64__
+
+#include "FlashBackend.h"
+
+#include <kinetis.h>
+
+#include "Flasher.h"
+
+
+#define FLASH_WRITE_WORD_CMD 0x06                 /**< Flash write word command code */
+#define FLASH_ERASE_SECTOR_CMD 0x09               /**< Flash sector erase command code */
+#define CPU_RESTART_ADDR ((uint32_t *)0xE000ED0C) /**< CPU restart register address */
+#define CPU_RESTART_VAL 0x5FA0004                 /**< CPU restart register value  */
+
+/**< Data memory barrier instruction definition. */
+#define _DMB()                 \
+    do                         \
+    {                          \
+        __asm volatile("dmb"); \
+    } while (0)
+
+extern unsigned long _etext; /**< End of .text section label */
+extern unsigned long _sdata; /**< Start of .data section label */
+extern unsigned long _edata; /**< Ennd of .data section label */
+
+
+/*
+ *  Launch command loaded to FCCOB registers and wait for completion.
+ *
+ *  @param reenable_irq  If true will leave IRQ enabled, disabled if false.
+ *  @return              Flasher return code
+ */
+RAMFUNC static int FlashBackend_LaunchCmd(bool reenable_irq);
+
+
+RAMFUNC int FlashBackend_ProgramWord(uint32_t address, uint32_t word_value, bool reenable_irq)
+{
+    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
+    {
+    };
+    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
+
+    *(uint32_t *)&FTFL_FCCOB3 = address;
+    *(uint32_t *)&FTFL_FCCOB7 = word_value;
+    FTFL_FCCOB0               = FLASH_WRITE_WORD_CMD;
+
+    return FlashBackend_LaunchCmd(reenable_irq);
+}
+
+RAMFUNC int FlashBackend_EraseSector(uint32_t address, bool reenable_irq)
+{
+    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
+    {
+    };
+    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
+
+    *(uint32_t *)&FTFL_FCCOB3 = address;
+    FTFL_FCCOB0               = FLASH_ERASE_SECTOR_CMD;
+
+    return FlashBackend_LaunchCmd(reenable_irq);
+}
+
+RAMFUNC void FlashBackend_DisableIrq(void)
+{
+    __disable_irq();
+}
+
+RAMFUNC void FlashBackend_Restart(void)
+{
+    *CPU_RESTART_ADDR = CPU_RESTART_VAL;
+}
+
+uint32_t FlashBackend_GetFirmwareEnd(void)
+{
+    return (uint32_t)&_etext + (uint32_t)&_edata - (uint32_t)&_sdata;
+}
+
+
+RAMFUNC int FlashBackend_LaunchCmd(bool reenable_irq)
+{
+    __disable_irq();
+
+    FTFL_FSTAT = FTFL_FSTAT_CCIF;
+    while ((FTFL_FSTAT & FTFL_FSTAT_CCIF) == 0)
+    {
+    };
+    MCM_PLACR |= MCM_PLACR_CFCC;
+
+    _DMB();
+
+    if (reenable_irq)
+        __enable_irq();
+
+    if (FTFL_FSTAT & FTFL_FSTAT_RDCOLERR)
+    {
+        return FLASHER_ERROR_COLLISION;
+    }
+    if (FTFL_FSTAT & FTFL_FSTAT_ACCERR)
+    {
+        return FLASHER_ERROR_ACCESS;
+    }
+    if (FTFL_FSTAT & FTFL_FSTAT_FPVIOL)
+    {
+        return FLASHER_ERROR_PROTECTION;
+    }
+    if (FTFL_FSTAT & FTFL_FSTAT_MGSTAT0)
+    {
+        return FLASHER_ERROR_CONTROLLER;
+    }
+
+    return FLASHER_SUCCESS;
+}
+
+#endif    // __MKL26Z64__
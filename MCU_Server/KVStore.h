@@ -0,0 +1,78 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef KV_STORE_H_
+#define KV_STORE_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**< Key value store return codes */
+#define KV_STORE_SUCCESS 0
+#define KV_STORE_ERROR_NOT_FOUND 1
+#define KV_STORE_ERROR_SIZE 2
+#define KV_STORE_ERROR_FLASH 3
+
+#define KV_STORE_MAX_VALUE_LEN 64u /**< Maximal length of single value */
+
+/**< Keys of stored values */
+#define KV_KEY_DFU_PROGRESS 0x01u     /**< Progress of interrupted DFU */
+#define KV_KEY_INSTANCE_INDICES 0x02u /**< Model instance indices received in last Init Node Event */
+#define KV_KEY_LIGHTNESS_STATE 0x03u  /**< Target lightness and temperature */
+#define KV_KEY_DFU_INSTALL 0x04u      /**< Install record of firmware installed with DFU */
+
+
+/*
+ *  Find active sector of the store and end of its log. Store is formatted if none of sectors is valid.
+ */
+void KVStore_Init(void);
+
+/*
+ *  Read latest value of the key.
+ *
+ *  @param key       Key
+ *  @param p_value   [out] Value
+ *  @param len       Expected value length
+ *  @return          Key value store return code, KV_STORE_ERROR_SIZE if stored value has different length
+ */
+int KVStore_Read(uint8_t key, void *p_value, size_t len);
+
+/*
+ *  Append new value of the key. Nothing is written if stored value is the same.
+ *
+ *  @param key       Key
+ *  @param p_value   Value
+ *  @param len       Value length, up to KV_STORE_MAX_VALUE_LEN
+ *  @return          Key value store return code
+ */
+int KVStore_Write(uint8_t key, const void *p_value, size_t len);
+
+/*
+ *  Remove the key from the store.
+ *
+ *  @param key       Key
+ *  @return          Key value store return code
+ */
+int KVStore_Delete(uint8_t key);
+
+#endif    // KV_STORE_H_
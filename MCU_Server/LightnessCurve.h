@@ -0,0 +1,254 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LIGHTNESS_CURVE_H_
+#define LIGHTNESS_CURVE_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define LIGHTNESS_TABLE_FRACTION_BITS 8u /**< Fractional bits of interpolated PWM duty */
+
+#define CALIBRATION_POINTS_COUNT(points) (sizeof(points) / sizeof((points)[0])) /**< Number of calibration points */
+
+
+/*
+ *  Lightness curves convert normalized Lightness Actual (0.0 - 1.0) to normalized light output.
+ *  They are evaluated at compile time only, when LightnessTable is generated.
+ */
+
+/*
+ *  Square law from Mesh Model specification, chapter 6.1.2.2.1
+ */
+struct LightnessCurveSquare
+{
+    static constexpr double Linear(double actual)
+    {
+        return actual * actual;
+    }
+};
+
+/*
+ *  CIE 1931 lightness, Lightness Actual is treated as L* in range 0 - 100
+ */
+struct LightnessCurveCIE1931
+{
+    static constexpr double Linear(double actual)
+    {
+        double l_star = actual * 100.0;
+        double cube   = (l_star + 16.0) / 116.0;
+        return (l_star <= 8.0) ? l_star / 903.3 : cube * cube * cube;
+    }
+};
+
+/*
+ *  Curve interpolated between equally spaced calibration points.
+ *  First point corresponds to input 0.0, last one to 1.0, points are normalized to UINT16_MAX.
+ *
+ *  @tparam Points   Calibration points
+ *  @tparam Count    Number of calibration points
+ */
+template <const uint16_t *Points, size_t Count>
+struct CalibrationCurve
+{
+    static_assert(Count >= 2, "At least two calibration points are required");
+
+    static constexpr double Linear(double actual)
+    {
+        constexpr size_t last = Count - 1;
+
+        double position = actual * last;
+        size_t index    = (position >= last) ? last - 1 : (size_t)position;
+        double fraction = position - index;
+        double low      = Points[index];
+        double high     = Points[index + 1];
+
+        return (low + (high - low) * fraction) / UINT16_MAX;
+    }
+};
+
+/*
+ *  Driver calibration, light output measured at equally spaced Lightness Actual values.
+ *  First point corresponds to Lightness Actual 0, last one to 0xFFFF.
+ *  Replace with values measured for used driver and LEDs.
+ */
+constexpr uint16_t LIGHTNESS_CALIBRATION_POINTS[] = {
+    0, 1024, 4096, 9216, 16384, 25600, 36864, 50176, 65535,
+};
+
+typedef CalibrationCurve<LIGHTNESS_CALIBRATION_POINTS, CALIBRATION_POINTS_COUNT(LIGHTNESS_CALIBRATION_POINTS)> LightnessCurveCalibration;
+
+/*
+ *  Output calibration of warm and cold LED strings, PWM duty required for equally spaced light output.
+ *  First point corresponds to no light, last one to full output of the string.
+ *  Replace with values measured for used LEDs, default is linear.
+ */
+constexpr uint16_t OUTPUT_CALIBRATION_POINTS_WARM[] = {
+    0, 8192, 16384, 24576, 32768, 40960, 49152, 57344, 65535,
+};
+
+constexpr uint16_t OUTPUT_CALIBRATION_POINTS_COLD[] = {
+    0, 8192, 16384, 24576, 32768, 40960, 49152, 57344, 65535,
+};
+
+typedef CalibrationCurve<OUTPUT_CALIBRATION_POINTS_WARM, CALIBRATION_POINTS_COUNT(OUTPUT_CALIBRATION_POINTS_WARM)> OutputCurveWarm;
+
+typedef CalibrationCurve<OUTPUT_CALIBRATION_POINTS_COLD, CALIBRATION_POINTS_COUNT(OUTPUT_CALIBRATION_POINTS_COLD)> OutputCurveCold;
+
+/*
+ *  Find input of monotonic curve producing given output, by bisection at compile time
+ *
+ *  @tparam Curve    Curve to be inverted
+ *  @param linear    Curve output (0.0 - 1.0)
+ *  @return          Curve input (0.0 - 1.0)
+ */
+template <typename Curve>
+constexpr double InverseCurve(double linear)
+{
+    double low  = 0.0;
+    double high = 1.0;
+    for (size_t i = 0; i < 40; i++)
+    {
+        double mid = (low + high) / 2;
+        if (Curve::Linear(mid) < linear)
+            low = mid;
+        else
+            high = mid;
+    }
+    return (low + high) / 2;
+}
+
+/*
+ *  Ease in/out transition profile (smoothstep), converts normalized time to normalized progress
+ */
+struct TransitionCurveEaseInOut
+{
+    static constexpr double Linear(double time)
+    {
+        return time * time * (3.0 - 2.0 * time);
+    }
+};
+
+/*
+ *  CIE 1931 L* (0.0 - 1.0) to Lightness Actual producing it with given lightness curve
+ */
+template <typename Curve>
+struct TransitionCurveFromLStar
+{
+    static constexpr double Linear(double l_star)
+    {
+        return InverseCurve<Curve>(LightnessCurveCIE1931::Linear(l_star));
+    }
+};
+
+/*
+ *  Lightness Actual to PWM duty lookup table generated at compile time
+ *
+ *  @tparam Curve       Lightness curve
+ *  @tparam Size        Number of table entries, power of two plus one
+ *  @tparam OutputMin   PWM duty for the lowest non zero lightness
+ *  @tparam OutputMax   PWM duty for the highest lightness
+ */
+template <typename Curve, size_t Size, uint16_t OutputMin, uint16_t OutputMax>
+struct LightnessTable
+{
+    static_assert(Size >= 3 && ((Size - 1) & (Size - 2)) == 0, "Table size has to be power of two plus one");
+
+    static constexpr uint32_t Shift()
+    {
+        uint32_t shift = 16;
+        for (size_t steps = Size - 1; steps > 1; steps >>= 1)
+        {
+            shift--;
+        }
+        return shift;
+    }
+
+    constexpr LightnessTable() : Output()
+    {
+        for (size_t i = 0; i < Size; i++)
+        {
+            double linear = Curve::Linear((double)i / (Size - 1));
+            Output[i]     = (uint16_t)(OutputMin + linear * (OutputMax - OutputMin) + 0.5);
+        }
+    }
+
+    /*
+     *  Get PWM duty for Lightness Actual, interpolated between table entries
+     *
+     *  @param actual  Lightness Actual
+     *  @return        PWM duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits, 0 for lightness 0
+     */
+    uint32_t Lookup(uint16_t actual) const
+    {
+        if (actual == 0)
+        {
+            return 0;
+        }
+
+        // Scale 0 - 0xFFFF to 0 - 0x10000, so 0xFFFF hits last entry exactly
+        uint32_t position = (uint32_t)actual + (actual >> 15);
+        uint32_t index    = position >> Shift();
+        uint32_t fraction = position & ((1u << Shift()) - 1);
+        uint32_t duty     = (uint32_t)Output[index] << LIGHTNESS_TABLE_FRACTION_BITS;
+
+        if (fraction == 0)
+        {
+            return duty;
+        }
+
+        int32_t delta = ((int32_t)Output[index + 1] - Output[index]) * (int32_t)fraction;
+        if (Shift() >= LIGHTNESS_TABLE_FRACTION_BITS)
+            delta >>= Shift() - LIGHTNESS_TABLE_FRACTION_BITS;
+        else
+            delta <<= LIGHTNESS_TABLE_FRACTION_BITS - Shift();
+
+        return duty + delta;
+    }
+
+    /*
+     *  Find lowest Lightness Actual for which Lookup returns at least given value, table has to be increasing
+     *
+     *  @param duty    PWM duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits
+     *  @return        Lightness Actual
+     */
+    uint16_t ReverseLookup(uint32_t duty) const
+    {
+        // Bisection calls Lookup 16 times and doesn't divide
+        uint32_t low  = 0;
+        uint32_t high = UINT16_MAX;
+        while (low < high)
+        {
+            uint32_t mid = (low + high) / 2;
+            if (Lookup(mid) < duty)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+    uint16_t Output[Size];
+};
+
+#endif    // LIGHTNESS_CURVE_H_
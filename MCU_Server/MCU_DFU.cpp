@@ -22,15 +22,21 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "MCU_DFU.h"
 
+#include <stddef.h>
 #include <string.h>
 
 #include "CRC.h"
 #include "Config.h"
+#include "DfuImage.h"
+#include "KVStore.h"
+#include "MCU_Health.h"
+#include "Scratch.h"
 #include "UARTProtocol.h"
 
 
 #define SHA256_SIZE 32u
-#define MAX_PAGE_SIZE 1024UL
+#define MIN_PAGE_SIZE 256UL  /**< Smaller page buffer is not allocated, DFU is not started */
+#define MAX_PAGE_SIZE 4096UL /**< Page buffer is not larger even if more RAM is available */
 
 #define DFU_INVALID_CODE 0x00
 #define DFU_SUCCESS 0x01
@@ -53,14 +59,89 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 /**< Defines string that forces update */
 #define DFU_VALIDATION_IGNORE_STRING "ignore"
 
+#define DFU_ERASED_BYTE 0xFFu
 
-static uint8_t DfuInProgress             = 0;
-static size_t  FirmwareSize              = 0;
-static size_t  FirmwareOffset            = 0;
-static uint8_t Sha256[SHA256_SIZE]       = {0};
-static uint8_t PageBuffer[MAX_PAGE_SIZE] = {0};
-static size_t  PageOffset                = 0;
-static size_t  PageSize                  = 0;
+/**< Progress is saved once per this many bytes to limit key value store compactions, smaller images after every page */
+#define DFU_PROGRESS_SAVE_INTERVAL 4096u
+
+/**< Firmware integrity check configuration */
+#define DFU_SCRUB_SLICE_US 100u      /**< Maximal time spent on integrity check in one loop iteration */
+#define DFU_SCRUB_CHUNK_SIZE 16u     /**< Number of bytes checked at once */
+#define DFU_SCRUB_INTERVAL_MS 60000u /**< Time between integrity check passes */
+#define DFU_FIRMWARE_FAULT_ID 0x80u  /**< Vendor specific Health fault, running firmware is corrupted */
+
+/**< Windowed transfer configuration */
+#define DFU_WINDOW_MAP_SIZE(page_size) ((page_size) / 8) /**< One bit per window byte already received */
+#define DFU_WINDOW_ACK_INTERVAL_MS 100u /**< Minimal interval between acks triggered by retransmitted data */
+#define DFU_WINDOW_PAGES 4u             /**< Pages in flight, page buffer is split between them */
+#define DFU_WINDOW_WRITE_HEADER_LEN 5u  /**< Image offset (4), data length */
+
+
+/*
+ *  Progress record, saved in key value store after every stored page
+ */
+typedef struct
+{
+    uint32_t firmware_size;
+    uint8_t  sha256[SHA256_SIZE];
+    uint32_t offset;
+    uint32_t crc;
+} DfuProgress_T;
+
+/*
+ *  Install record, saved in key value store before firmware is copied over running one
+ */
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t firmware_size;
+    uint8_t  sha256[SHA256_SIZE];
+    uint32_t confirmed; /**< Set when new firmware starts */
+    uint32_t crc;       /**< CRC32 of running firmware, saved when firmware is confirmed */
+} DfuInstallRecord_T;
+
+/*
+ *  Timings and counters of last DFU, kept after DFU ends
+ */
+typedef struct
+{
+    uint32_t start_timestamp;
+    uint32_t page_timestamp; /**< Start of current page reception */
+    uint32_t transfer_ms;    /**< Time from Init Request to last page stored */
+    uint32_t init_ms;        /**< Space erase or progress record validation */
+    uint32_t receive_ms;     /**< Sum of page reception times */
+    uint32_t program_ms;     /**< Sum of page decode and flash times */
+    uint32_t hash_ms;        /**< Image SHA256 validation */
+    uint32_t bytes;
+    uint16_t pages;
+    uint16_t retries; /**< Abandoned pages, failed stores and repeated window data */
+} DfuStats_T;
+
+
+static uint8_t  DfuInProgress       = 0;
+static size_t   FirmwareSize        = 0;
+static size_t   FirmwareOffset      = 0;
+static uint32_t FirmwareCrc         = ~CRC32_INIT_VAL;
+static uint8_t  Sha256[SHA256_SIZE] = {0};
+static uint8_t *PageBuffer          = NULL;
+static size_t   PageBufferSize      = 0;
+static size_t   PageOffset          = 0;
+static size_t   PageSize            = 0;
+static bool     WindowMode          = false;
+static uint8_t *WindowMap           = NULL;
+static size_t   WindowPageSize      = 0;
+static size_t   WindowHead          = 0; /**< Slot of page at committed offset */
+static uint32_t WindowAckTimestamp  = 0;
+
+static uint16_t WindowFill[DFU_WINDOW_PAGES]; /**< Received bytes of page in each slot */
+
+static DfuStats_T         Stats;
+static DfuInstallRecord_T InstallRecord; /**< Record of running firmware, read at startup */
+
+static size_t   ScrubOffset        = 0;
+static uint32_t ScrubCrc           = ~CRC32_INIT_VAL;
+static uint32_t ScrubTimestamp     = 0;
+static bool     ScrubFaultReported = false;
 
 
 /*
@@ -69,14 +150,130 @@ static size_t  PageSize                  = 0;
 static void MCU_DFU_ClearStates(void);
 
 /*
- *  Calculate CRC of data saved in flash and ram
+ *  Calculate CRC of data received so far
  */
 static uint32_t MCU_DFU_CalcCRC(void);
 
+/*
+ *  Get page size which can be used for DFU
+ *
+ *  @return    Size of allocated page buffer if DFU is in progress,
+ *             otherwise largest page buffer which fits in free RAM
+ */
+static size_t MCU_DFU_GetMaxPageSize(void);
+
+/*
+ *  Take page buffer and window map from scratch arena
+ *
+ *  @return    True if page buffer has been allocated, false otherwise
+ */
+static bool MCU_DFU_AllocPageBuffer(void);
+
+/*
+ *  Decode and save completely received page, update committed offset and CRC
+ *
+ *  @param p_page    Pointer to page data
+ *  @param len       Page length
+ *  @return          DFU status code
+ */
+static uint8_t MCU_DFU_StorePage(const uint8_t *p_page, size_t len);
+
+/*
+ *  Validate image after last page has been stored
+ *
+ *  @return    DFU status code, DFU_FIRMWARE_SUCCESSFULLY_UPDATED if image is valid
+ */
+static uint8_t MCU_DFU_Complete(void);
+
+/*
+ *  Copy new firmware over running one, does not return
+ */
+static void MCU_DFU_ApplyUpdate(void);
+
+/*
+ *  Open window of DFU_WINDOW_PAGES pages from committed offset
+ */
+static void MCU_DFU_StartWindow(void);
+
+/*
+ *  Get length of page in window
+ *
+ *  @param page      Index of page in window, 0 is page at committed offset
+ *  @return          Page length, 0 if page is after end of image
+ */
+static size_t MCU_DFU_GetWindowPageLen(size_t page);
+
+/*
+ *  Store completely received pages from committed offset
+ *
+ *  @return          DFU status code
+ */
+static uint8_t MCU_DFU_StoreWindowPages(void);
+
+/*
+ *  Send cumulative acknowledgement of windowed transfer
+ *
+ *  @param status    DFU status code
+ *  @param force     Send even if previous ack was sent less than DFU_WINDOW_ACK_INTERVAL_MS ago
+ */
+static void MCU_DFU_SendWindowAck(uint8_t status, bool force);
+
+/*
+ *  Restore progress of interrupted DFU of the same image
+ *
+ *  @return    True if DFU can be resumed, false otherwise
+ */
+static bool MCU_DFU_LoadProgress(void);
+
+/*
+ *  Check if part of DFU space is erased
+ *
+ *  @param from      First offset to check
+ *  @param to        Offset after last checked byte
+ *  @return          True if all bytes are erased
+ */
+static bool MCU_DFU_IsSpaceErased(size_t from, size_t to);
+
+/*
+ *  Save committed offset and CRC to progress record
+ */
+static void MCU_DFU_SaveProgress(void);
+
+/*
+ *  Erase progress record
+ */
+static void MCU_DFU_ClearProgress(void);
+
+/*
+ *  Calculate average transfer throughput
+ *
+ *  @param transfer_ms    Transfer time
+ *  @return               Throughput in bytes per second
+ */
+static uint32_t MCU_DFU_GetThroughput(uint32_t transfer_ms);
+
+/*
+ *  Print summary of DFU timings and counters
+ */
+static void MCU_DFU_PrintStats(void);
+
+/*
+ *  Save install record of validated image
+ *
+ *  @param image_size    Size of image stored in DFU space
+ */
+static void MCU_DFU_SaveInstallRecord(size_t image_size);
+
+/*
+ *  Confirm firmware started after install
+ */
+static void MCU_DFU_CheckInstall(void);
+
 
 void SetupDFU(void)
 {
     MCU_DFU_ClearStates();
+    MCU_DFU_CheckInstall();
 
     INFO("DFU space start addr: %016X\n\n", Flasher_GetSpaceAddr());
     INFO("DFU available bytes:  %d\n\n", Flasher_GetSpaceSize());
@@ -87,6 +284,49 @@ bool MCU_DFU_IsInProgress(void)
     return (bool)DfuInProgress;
 }
 
+void LoopDFU(void)
+{
+    // Reference CRC is known only for firmware installed with DFU.
+    if (DfuInProgress || !InstallRecord.confirmed)
+    {
+        return;
+    }
+
+    if (ScrubOffset == 0 && (millis() - ScrubTimestamp) < DFU_SCRUB_INTERVAL_MS)
+    {
+        return;
+    }
+
+    uint32_t start = micros();
+    do
+    {
+        size_t len = InstallRecord.firmware_size - ScrubOffset;
+        if (len > DFU_SCRUB_CHUNK_SIZE)
+        {
+            len = DFU_SCRUB_CHUNK_SIZE;
+        }
+
+        ScrubCrc = CalcCRC32((uint8_t *)(FLASH_BASE_ADDR + ScrubOffset), len, ~ScrubCrc);
+        ScrubOffset += len;
+    } while (ScrubOffset < InstallRecord.firmware_size && (micros() - start) < DFU_SCRUB_SLICE_US);
+
+    if (ScrubOffset < InstallRecord.firmware_size)
+    {
+        return;
+    }
+
+    if (ScrubCrc != InstallRecord.crc && !ScrubFaultReported && GetHealthServerIdx() != INSTANCE_INDEX_UNKNOWN)
+    {
+        INFO("Firmware integrity check failed, CRC %08X\n", ScrubCrc);
+        MCU_Health_SendSetFaultRequest(SILVAIR_ID, DFU_FIRMWARE_FAULT_ID, GetHealthServerIdx());
+        ScrubFaultReported = true;
+    }
+
+    ScrubOffset    = 0;
+    ScrubCrc       = ~CRC32_INIT_VAL;
+    ScrubTimestamp = millis();
+}
+
 void ProcessDfuInitRequest(uint8_t *p_payload, uint8_t len)
 {
     MCU_DFU_ClearStates();
@@ -126,10 +366,22 @@ void ProcessDfuInitRequest(uint8_t *p_payload, uint8_t len)
         return;
     }
 
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.start_timestamp = millis();
+
     size_t available = Flasher_GetSpaceSize();
-    if (available > FirmwareSize)
+    if (available > FirmwareSize && MCU_DFU_AllocPageBuffer())
     {
-        Flasher_EraseSpace();
+        if (MCU_DFU_LoadProgress())
+        {
+            INFO("DFU Resumed at %d\n", FirmwareOffset);
+        }
+        else
+        {
+            Flasher_EraseSpace();
+            MCU_DFU_ClearProgress();
+        }
+        Stats.init_ms = millis() - Stats.start_timestamp;
 
         uint8_t init_status[] = {DFU_SUCCESS};
         UART_SendDfuInitResponse(init_status, sizeof(init_status));
@@ -154,16 +406,17 @@ void ProcessDfuInitRequest(uint8_t *p_payload, uint8_t len)
 
 void ProcessDfuStatusRequest(uint8_t *p_payload, uint8_t len)
 {
-    uint32_t offset = FirmwareOffset + PageOffset;
-    uint32_t crc    = MCU_DFU_CalcCRC();
+    uint32_t max_page = MCU_DFU_GetMaxPageSize();
+    uint32_t offset   = FirmwareOffset + PageOffset;
+    uint32_t crc      = MCU_DFU_CalcCRC();
 
     uint8_t response[] = {
         DFU_SUCCESS,
 
-        (uint8_t)MAX_PAGE_SIZE,
-        (uint8_t)(MAX_PAGE_SIZE >> 8),
-        (uint8_t)(MAX_PAGE_SIZE >> 16),
-        (uint8_t)(MAX_PAGE_SIZE >> 24),
+        (uint8_t)max_page,
+        (uint8_t)(max_page >> 8),
+        (uint8_t)(max_page >> 16),
+        (uint8_t)(max_page >> 24),
 
         (uint8_t)offset,
         (uint8_t)(offset >> 8),
@@ -177,7 +430,7 @@ void ProcessDfuStatusRequest(uint8_t *p_payload, uint8_t len)
     };
 
     UART_SendDfuStatusResponse(response, sizeof(response));
-    INFO("DFU Status:\nMax page: %08X\noffset:%08X\ncrc:%08X\n\n", MAX_PAGE_SIZE, offset, crc);
+    INFO("DFU Status:\nMax page: %08X\noffset:%08X\ncrc:%08X\n\n", max_page, offset, crc);
 }
 
 void ProcessDfuPageCreateRequest(uint8_t *p_payload, uint8_t len)
@@ -198,10 +451,17 @@ void ProcessDfuPageCreateRequest(uint8_t *p_payload, uint8_t len)
     req_page_size |= ((uint32_t)p_payload[index++] << 16);
     req_page_size |= ((uint32_t)p_payload[index++] << 24);
 
-    if (req_page_size <= MAX_PAGE_SIZE)
+    if (req_page_size <= PageBufferSize)
     {
+        if (PageOffset != 0)
+        {
+            Stats.retries++;
+        }
+        Stats.page_timestamp = millis();
+
         PageOffset = 0;
         PageSize   = req_page_size;
+        WindowMode = false;
 
         uint8_t response[] = {DFU_SUCCESS};
         UART_SendDfuPageCreateResponse(response, sizeof(response));
@@ -228,6 +488,12 @@ void ProcessDfuWriteDataEvent(uint8_t *p_payload, uint8_t len)
     uint8_t  image_len = p_payload[index++];
     uint8_t *p_image   = p_payload + index;
 
+    if (len < index + image_len)
+    {
+        INFO("DFU Write data, invalid length\n");
+        return;
+    }
+
     if (PageOffset + image_len <= PageSize)
     {
         memcpy(PageBuffer + PageOffset, p_image, image_len);
@@ -263,64 +529,127 @@ void ProcessDfuPageStoreRequest(uint8_t *p_payload, uint8_t len)
         return;
     }
 
-    uint32_t page_store_address = Flasher_GetSpaceAddr() + FirmwareOffset;
-    uint8_t  ret_val            = Flasher_SaveMemoryToFlash(page_store_address, (uint32_t *)PageBuffer, PageSize / 4);
-    if (ret_val != FLASHER_SUCCESS)
+    uint8_t status = MCU_DFU_StorePage(PageBuffer, PageSize);
+    if (status != DFU_SUCCESS)
     {
-        uint8_t response[] = {DFU_OPERATION_FAILED};
+        uint8_t response[] = {status};
         UART_SendDfuPageStoreResponse(response, sizeof(response));
-
-        INFO("DFU Page not stored, flasher fail\n");
         return;
     }
 
-    FirmwareOffset += PageOffset;
-    PageOffset = 0;
-    PageSize   = 0;
-
     if (FirmwareOffset != FirmwareSize)
     {
         uint8_t response[] = {DFU_SUCCESS};
         UART_SendDfuPageStoreResponse(response, sizeof(response));
+        return;
+    }
+
+    uint8_t response[] = {MCU_DFU_Complete()};
+    UART_SendDfuPageStoreResponse(response, sizeof(response));
+
+    if (response[0] == DFU_FIRMWARE_SUCCESSFULLY_UPDATED)
+    {
+        MCU_DFU_ApplyUpdate();
+    }
+}
 
-        INFO("DFU Page store success, CRC %08X\n",
-             CalcCRC32((uint8_t *)Flasher_GetSpaceAddr(), FirmwareOffset, CRC_INIT_VAL));
+void ProcessDfuWindowWriteEvent(uint8_t *p_payload, uint8_t len)
+{
+    if (!DfuInProgress)
+    {
+        UART_SendDfuCancelRequest(NULL, 0);
+        INFO("DFU Window write, dfu not in progress\n");
         return;
     }
-    else
+
+    if (len < DFU_WINDOW_WRITE_HEADER_LEN || len < DFU_WINDOW_WRITE_HEADER_LEN + p_payload[DFU_WINDOW_WRITE_HEADER_LEN - 1])
     {
-        DfuInProgress = 0;
+        INFO("DFU Window write, invalid length\n");
+        return;
     }
 
-    uint8_t calculated_sha256[SHA256_SIZE];
-    CalcSHA256((uint8_t *)Flasher_GetSpaceAddr(), FirmwareOffset, calculated_sha256);
-    bool is_object_valid = (0 == memcmp(calculated_sha256, Sha256, SHA256_SIZE));
+    if (!WindowMode)
+    {
+        WindowMode = true;
+        MCU_DFU_StartWindow();
+    }
 
-    if (!is_object_valid)
+    size_t   index = 0;
+    uint32_t offset;
+    offset = ((uint32_t)p_payload[index++]);
+    offset |= ((uint32_t)p_payload[index++] << 8);
+    offset |= ((uint32_t)p_payload[index++] << 16);
+    offset |= ((uint32_t)p_payload[index++] << 24);
+
+    uint8_t  image_len = p_payload[index++];
+    uint8_t *p_image   = p_payload + index;
+
+    size_t window_start = FirmwareOffset;
+    size_t window_end   = FirmwareOffset + DFU_WINDOW_PAGES * WindowPageSize;
+    size_t new_bytes    = 0;
+
+    if (window_end > FirmwareSize)
     {
-        uint8_t response[] = {DFU_INVALID_OBJECT};
-        UART_SendDfuPageStoreResponse(response, sizeof(response));
+        window_end = FirmwareSize;
+    }
 
-        INFO("DFU Invalid object\n");
-        MCU_DFU_ClearStates();
+    // Chunks may arrive out of order or repeated, only not yet received window bytes are taken.
+    for (size_t i = 0; i < image_len; i++)
+    {
+        size_t position = offset + i;
+        if (position < window_start || position >= window_end)
+            continue;
+
+        size_t  page       = (position - window_start) / WindowPageSize;
+        size_t  slot       = (WindowHead + page) % DFU_WINDOW_PAGES;
+        size_t  page_index = slot * WindowPageSize + (position - window_start) % WindowPageSize;
+        uint8_t mask       = 1u << (page_index % 8);
+        if (WindowMap[page_index / 8] & mask)
+            continue;
+
+        WindowMap[page_index / 8] |= mask;
+        PageBuffer[page_index] = p_image[i];
+        WindowFill[slot]++;
+        new_bytes++;
+    }
+
+    if (new_bytes != image_len)
+    {
+        Stats.retries++;
+    }
+
+    if (WindowFill[WindowHead] != MCU_DFU_GetWindowPageLen(0))
+    {
+        // Data outside of window or repeated means that modem missed an ack.
+        if (new_bytes != image_len)
+        {
+            MCU_DFU_SendWindowAck(DFU_SUCCESS, false);
+        }
         return;
     }
 
-    uint8_t response[] = {DFU_FIRMWARE_SUCCESSFULLY_UPDATED};
-    UART_SendDfuPageStoreResponse(response, sizeof(response));
+    uint8_t status = MCU_DFU_StoreWindowPages();
+    if (status != DFU_SUCCESS)
+    {
+        MCU_DFU_SendWindowAck(status, true);
+        if (DfuInProgress)
+        {
+            MCU_DFU_StartWindow();
+        }
+        return;
+    }
 
-    INFO("DFU Firmware updated\n");
-    DEBUG_INTERFACE.flush();
+    if (FirmwareOffset != FirmwareSize)
+    {
+        return;
+    }
 
-    Flasher_UpdateFirmware(FirmwareSize / 4);
+    status = MCU_DFU_Complete();
+    MCU_DFU_SendWindowAck(status, true);
 
-    //Should not get there
-    for (;;)
+    if (status == DFU_FIRMWARE_SUCCESSFULLY_UPDATED)
     {
-        digitalWrite(PIN_LED_STATUS, 0);
-        delay(1000);
-        digitalWrite(PIN_LED_STATUS, 1);
-        delay(1000);
+        MCU_DFU_ApplyUpdate();
     }
 }
 
@@ -342,29 +671,422 @@ void ProcessDfuCancelResponse(uint8_t *p_payload, uint8_t len)
     INFO("DFU Cancelled\n");
 }
 
+void ProcessDfuStatsRequest(uint8_t *p_payload, uint8_t len)
+{
+    uint32_t transfer_ms = DfuInProgress ? (millis() - Stats.start_timestamp) : Stats.transfer_ms;
+
+    uint32_t words[] = {
+        transfer_ms,
+        Stats.init_ms,
+        Stats.receive_ms,
+        Stats.program_ms,
+        Stats.hash_ms,
+        Stats.bytes,
+        MCU_DFU_GetThroughput(transfer_ms),
+    };
+
+    uint8_t response[1 + sizeof(words) + 2 * sizeof(uint16_t)];
+    size_t  index     = 0;
+    response[index++] = DfuInProgress ? DFU_STATUS_IN_PROGRESS : DFU_STATUS_NOT_IN_PROGRESS;
+
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+    {
+        response[index++] = (uint8_t)words[i];
+        response[index++] = (uint8_t)(words[i] >> 8);
+        response[index++] = (uint8_t)(words[i] >> 16);
+        response[index++] = (uint8_t)(words[i] >> 24);
+    }
+
+    response[index++] = (uint8_t)Stats.pages;
+    response[index++] = (uint8_t)(Stats.pages >> 8);
+    response[index++] = (uint8_t)Stats.retries;
+    response[index++] = (uint8_t)(Stats.retries >> 8);
+
+    UART_SendDfuStatsResponse(response, sizeof(response));
+}
+
 
 static void MCU_DFU_ClearStates(void)
 {
     DfuInProgress  = 0;
     FirmwareSize   = 0;
     FirmwareOffset = 0;
+    FirmwareCrc    = ~CRC32_INIT_VAL;
     PageOffset     = 0;
     PageSize       = 0;
+    WindowMode     = false;
+    WindowPageSize = 0;
+    WindowHead     = 0;
 
     memset(Sha256, 0, SHA256_SIZE);
-    memset(PageBuffer, 0, MAX_PAGE_SIZE);
+    DfuImage_Init();
+
+    Scratch_Release();
+    PageBuffer     = NULL;
+    PageBufferSize = 0;
+    WindowMap      = NULL;
 }
 
 static uint32_t MCU_DFU_CalcCRC(void)
 {
-    uint32_t crc = ~CRC32_INIT_VAL;
-    if (FirmwareOffset != 0)
-    {
-        crc = CalcCRC32((uint8_t *)Flasher_GetSpaceAddr(), FirmwareOffset, ~crc);
-    }
+    uint32_t crc = FirmwareCrc;
     if (PageOffset != 0)
     {
         crc = CalcCRC32(PageBuffer, PageOffset, ~crc);
     }
     return crc;
 }
+
+static size_t MCU_DFU_GetMaxPageSize(void)
+{
+    if (PageBuffer != NULL)
+    {
+        return PageBufferSize;
+    }
+
+    size_t available = Scratch_GetAvailable();
+    size_t page_size = MAX_PAGE_SIZE;
+    while (page_size > MIN_PAGE_SIZE && page_size + DFU_WINDOW_MAP_SIZE(page_size) > available)
+    {
+        page_size /= 2;
+    }
+
+    return page_size;
+}
+
+static bool MCU_DFU_AllocPageBuffer(void)
+{
+    for (size_t page_size = MCU_DFU_GetMaxPageSize(); page_size >= MIN_PAGE_SIZE; page_size /= 2)
+    {
+        PageBuffer = Scratch_Acquire(page_size + DFU_WINDOW_MAP_SIZE(page_size));
+        if (PageBuffer != NULL)
+        {
+            PageBufferSize = page_size;
+            WindowMap      = PageBuffer + page_size;
+
+            INFO("DFU Page buffer: %d\n", PageBufferSize);
+            return true;
+        }
+    }
+
+    INFO("DFU Page buffer allocation failed\n");
+    return false;
+}
+
+static uint8_t MCU_DFU_StorePage(const uint8_t *p_page, size_t len)
+{
+    uint32_t timestamp = millis();
+    Stats.receive_ms += timestamp - Stats.page_timestamp;
+
+    int ret_val = DfuImage_Write(p_page, len);
+    Stats.program_ms += millis() - timestamp;
+
+    // Decoder of encoded image has already consumed the page, so only not encoded page can be sent again.
+    if (ret_val == DFU_IMAGE_ERROR_FLASH && !DfuImage_IsEncoded())
+    {
+        INFO("DFU Page not stored, flasher fail\n");
+        Stats.retries++;
+        return DFU_OPERATION_FAILED;
+    }
+    if (ret_val == DFU_IMAGE_ERROR_FLASH)
+    {
+        INFO("DFU Aborted, flasher fail while decoding image\n");
+        MCU_DFU_ClearProgress();
+        MCU_DFU_ClearStates();
+        return DFU_OPERATION_FAILED;
+    }
+    if (ret_val != DFU_IMAGE_SUCCESS)
+    {
+        INFO("DFU Page not stored, invalid image\n");
+        MCU_DFU_ClearProgress();
+        MCU_DFU_ClearStates();
+        return ret_val == DFU_IMAGE_ERROR_SIZE ? DFU_INSUFFICIENT_RESOURCES : DFU_INVALID_OBJECT;
+    }
+
+    size_t previous_offset = FirmwareOffset;
+
+    FirmwareCrc = CalcCRC32((uint8_t *)p_page, len, ~FirmwareCrc);
+    FirmwareOffset += len;
+    Stats.bytes += len;
+    Stats.pages++;
+    PageOffset = 0;
+    PageSize   = 0;
+
+    if (FirmwareOffset != FirmwareSize)
+    {
+        if (FirmwareSize < DFU_PROGRESS_SAVE_INTERVAL ||
+            FirmwareOffset / DFU_PROGRESS_SAVE_INTERVAL != previous_offset / DFU_PROGRESS_SAVE_INTERVAL)
+        {
+            MCU_DFU_SaveProgress();
+        }
+        INFO("DFU Page store success, CRC %08X\n", FirmwareCrc);
+    }
+
+    return DFU_SUCCESS;
+}
+
+static uint8_t MCU_DFU_Complete(void)
+{
+    DfuInProgress = 0;
+    MCU_DFU_ClearProgress();
+
+    if (DfuImage_Finish() != DFU_IMAGE_SUCCESS)
+    {
+        INFO("DFU Invalid object, image decoding failed\n");
+        MCU_DFU_ClearStates();
+        return DFU_INVALID_OBJECT;
+    }
+
+    uint32_t timestamp = millis();
+    Stats.transfer_ms  = timestamp - Stats.start_timestamp;
+
+    uint8_t calculated_sha256[SHA256_SIZE];
+    CalcSHA256((uint8_t *)(uintptr_t)Flasher_GetSpaceAddr(), DfuImage_GetSize(), calculated_sha256);
+    bool is_object_valid = (0 == memcmp(calculated_sha256, Sha256, SHA256_SIZE));
+
+    Stats.hash_ms = millis() - timestamp;
+    MCU_DFU_PrintStats();
+
+    if (!is_object_valid)
+    {
+        INFO("DFU Invalid object\n");
+        MCU_DFU_ClearStates();
+        return DFU_INVALID_OBJECT;
+    }
+
+    return DFU_FIRMWARE_SUCCESSFULLY_UPDATED;
+}
+
+static void MCU_DFU_ApplyUpdate(void)
+{
+    INFO("DFU Firmware updated\n");
+    DEBUG_INTERFACE.flush();
+
+    MCU_DFU_SaveInstallRecord(DfuImage_GetSize());
+    Flasher_UpdateFirmware(Flasher_GetSpaceAddr(), DfuImage_GetSize() / 4);
+
+    //Should not get there
+    for (;;)
+    {
+        digitalWrite(PIN_LED_STATUS, 0);
+        delay(1000);
+        digitalWrite(PIN_LED_STATUS, 1);
+        delay(1000);
+    }
+}
+
+static void MCU_DFU_StartWindow(void)
+{
+    PageOffset     = 0;
+    PageSize       = 0;
+    WindowPageSize = PageBufferSize / DFU_WINDOW_PAGES;
+    WindowHead     = 0;
+
+    Stats.page_timestamp = millis();
+    memset(WindowFill, 0, sizeof(WindowFill));
+    memset(WindowMap, 0, DFU_WINDOW_MAP_SIZE(PageBufferSize));
+}
+
+static size_t MCU_DFU_GetWindowPageLen(size_t page)
+{
+    size_t start = FirmwareOffset + page * WindowPageSize;
+    if (start >= FirmwareSize)
+    {
+        return 0;
+    }
+
+    return (FirmwareSize - start < WindowPageSize) ? FirmwareSize - start : WindowPageSize;
+}
+
+static uint8_t MCU_DFU_StoreWindowPages(void)
+{
+    // Later pages may be complete before the page at committed offset, they are stored when it is.
+    while (FirmwareOffset != FirmwareSize && WindowFill[WindowHead] == MCU_DFU_GetWindowPageLen(0))
+    {
+        uint8_t status = MCU_DFU_StorePage(PageBuffer + WindowHead * WindowPageSize, WindowFill[WindowHead]);
+        if (status != DFU_SUCCESS)
+        {
+            return status;
+        }
+
+        WindowFill[WindowHead] = 0;
+        memset(WindowMap + DFU_WINDOW_MAP_SIZE(WindowHead * WindowPageSize), 0, DFU_WINDOW_MAP_SIZE(WindowPageSize));
+        WindowHead           = (WindowHead + 1) % DFU_WINDOW_PAGES;
+        Stats.page_timestamp = millis();
+
+        if (FirmwareOffset != FirmwareSize)
+        {
+            MCU_DFU_SendWindowAck(DFU_SUCCESS, true);
+        }
+    }
+
+    return DFU_SUCCESS;
+}
+
+static void MCU_DFU_SendWindowAck(uint8_t status, bool force)
+{
+    if (!force && (millis() - WindowAckTimestamp) < DFU_WINDOW_ACK_INTERVAL_MS)
+    {
+        return;
+    }
+    WindowAckTimestamp = millis();
+
+    uint32_t offset = FirmwareOffset;
+    uint32_t crc    = FirmwareCrc;
+
+    // Bit n is set if page n after committed offset is completely received, so modem resends only missing pages.
+    uint8_t received_pages = 0;
+    for (size_t page = 1; page < DFU_WINDOW_PAGES && WindowPageSize != 0; page++)
+    {
+        size_t page_len = MCU_DFU_GetWindowPageLen(page);
+        if (page_len != 0 && WindowFill[(WindowHead + page) % DFU_WINDOW_PAGES] == page_len)
+        {
+            received_pages |= 1u << page;
+        }
+    }
+
+    uint8_t response[] = {
+        status,
+
+        (uint8_t)offset,
+        (uint8_t)(offset >> 8),
+        (uint8_t)(offset >> 16),
+        (uint8_t)(offset >> 24),
+
+        (uint8_t)crc,
+        (uint8_t)(crc >> 8),
+        (uint8_t)(crc >> 16),
+        (uint8_t)(crc >> 24),
+
+        received_pages,
+    };
+
+    UART_SendDfuWindowAckEvent(response, sizeof(response));
+}
+
+static bool MCU_DFU_LoadProgress(void)
+{
+    DfuProgress_T progress;
+
+    if (KVStore_Read(KV_KEY_DFU_PROGRESS, &progress, sizeof(progress)) != KV_STORE_SUCCESS ||
+        progress.firmware_size != FirmwareSize || memcmp(progress.sha256, Sha256, SHA256_SIZE) != 0)
+    {
+        return false;
+    }
+
+    if (progress.offset == 0 || progress.offset >= FirmwareSize || progress.offset % sizeof(uint32_t) != 0 ||
+        progress.crc != CalcCRC32((uint8_t *)(uintptr_t)Flasher_GetSpaceAddr(), progress.offset, CRC32_INIT_VAL))
+    {
+        return false;
+    }
+
+    // Pages stored after last saved progress, or part of next page flashed before reset, are already
+    // programmed. Resent pages can't be programmed over them, so they are erased from the sector
+    // containing the saved offset and transfer is resumed from its start.
+    if (!MCU_DFU_IsSpaceErased(progress.offset, FirmwareSize))
+    {
+        progress.offset -= progress.offset % Flasher_GetSectorSize();
+        if (progress.offset == 0 || Flasher_EraseSpaceFrom(progress.offset) != FLASHER_SUCCESS)
+        {
+            return false;
+        }
+        progress.crc = CalcCRC32((uint8_t *)(uintptr_t)Flasher_GetSpaceAddr(), progress.offset, CRC32_INIT_VAL);
+    }
+
+    FirmwareOffset = progress.offset;
+    FirmwareCrc    = progress.crc;
+    DfuImage_Resume(progress.offset);
+
+    return true;
+}
+
+static bool MCU_DFU_IsSpaceErased(size_t from, size_t to)
+{
+    const volatile uint8_t *p_space = (const volatile uint8_t *)(uintptr_t)Flasher_GetSpaceAddr();
+
+    for (size_t offset = from; offset < to; offset++)
+    {
+        if (p_space[offset] != DFU_ERASED_BYTE)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void MCU_DFU_SaveProgress(void)
+{
+    // Encoded images can't be resumed, decoder state is not saved.
+    if (DfuImage_IsEncoded())
+    {
+        return;
+    }
+
+    DfuProgress_T progress;
+    progress.firmware_size = FirmwareSize;
+    memcpy(progress.sha256, Sha256, SHA256_SIZE);
+    progress.offset = FirmwareOffset;
+    progress.crc    = FirmwareCrc;
+
+    KVStore_Write(KV_KEY_DFU_PROGRESS, &progress, sizeof(progress));
+}
+
+static void MCU_DFU_ClearProgress(void)
+{
+    KVStore_Delete(KV_KEY_DFU_PROGRESS);
+}
+
+static uint32_t MCU_DFU_GetThroughput(uint32_t transfer_ms)
+{
+    return (transfer_ms != 0) ? (uint32_t)((uint64_t)Stats.bytes * 1000 / transfer_ms) : 0;
+}
+
+static void MCU_DFU_PrintStats(void)
+{
+    INFO("DFU Stats:\nTransfer: %d ms, %d B, %d B/s\n",
+         Stats.transfer_ms,
+         Stats.bytes,
+         MCU_DFU_GetThroughput(Stats.transfer_ms));
+    INFO("Init: %d ms\nReceive: %d ms\nProgram: %d ms\nHash: %d ms\n",
+         Stats.init_ms,
+         Stats.receive_ms,
+         Stats.program_ms,
+         Stats.hash_ms);
+    INFO("Pages: %d\nRetries: %d\n\n", Stats.pages, Stats.retries);
+}
+
+static void MCU_DFU_SaveInstallRecord(size_t image_size)
+{
+    DfuInstallRecord_T record;
+    bool               is_found = (KVStore_Read(KV_KEY_DFU_INSTALL, &record, sizeof(record)) == KV_STORE_SUCCESS);
+
+    record.sequence      = is_found ? record.sequence + 1 : 1;
+    record.firmware_size = image_size;
+    memcpy(record.sha256, Sha256, SHA256_SIZE);
+    record.confirmed = 0;
+    record.crc       = 0;
+
+    KVStore_Write(KV_KEY_DFU_INSTALL, &record, sizeof(record));
+}
+
+static void MCU_DFU_CheckInstall(void)
+{
+    if (KVStore_Read(KV_KEY_DFU_INSTALL, &InstallRecord, sizeof(InstallRecord)) != KV_STORE_SUCCESS)
+    {
+        InstallRecord.confirmed = 0;
+        return;
+    }
+
+    if (InstallRecord.confirmed)
+    {
+        INFO("Firmware #%d\n\n", InstallRecord.sequence);
+        return;
+    }
+
+    // Reference for integrity checks, calculated over flash as it is, including flash config field.
+    InstallRecord.confirmed = 1;
+    InstallRecord.crc       = CalcCRC32((uint8_t *)FLASH_BASE_ADDR, InstallRecord.firmware_size, CRC32_INIT_VAL);
+    KVStore_Write(KV_KEY_DFU_INSTALL, &InstallRecord, sizeof(InstallRecord));
+    INFO("Firmware #%d confirmed, CRC %08X\n\n", InstallRecord.sequence, InstallRecord.crc);
+}
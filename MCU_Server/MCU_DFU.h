@@ -38,4 +38,10 @@ void SetupDFU(void);
  */
 bool MCU_DFU_IsInProgress(void);
 
+/*
+ * DFU main function, should be called in Arduino main loop.
+ * Checks integrity of running firmware in short time slices.
+ */
+void LoopDFU(void);
+
 #endif    // MCU_DFU_H
\ No newline at end of file
@@ -57,15 +57,6 @@ static uint32_t TestStartTimestamp = 0;                      /**  Time left to f
 static uint8_t  TestStartPayload[TEST_MSG_LEN];              /**  Current test payload.*/
 
 
-/*
- *  Send Health Set Fault Request
- *
- *  @param company_id      Company id
- *  @param fault_id        Fault id
- *  @param instance_idx    Instance index
- */
-static void MCU_Health_SendSetFaultRequest(uint16_t company_id, uint8_t fault_id, uint8_t instance_idx);
-
 /*
  *  Send Health Clear Fault Request
  *
@@ -30,6 +30,15 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define SILVAIR_ID 0x0136u
 
 
+/*
+ *  Send Health Set Fault Request
+ *
+ *  @param company_id      Company id
+ *  @param fault_id        Fault id
+ *  @param instance_idx    Instance index
+ */
+void MCU_Health_SendSetFaultRequest(uint16_t company_id, uint8_t fault_id, uint8_t instance_idx);
+
 /*
  *  Check if there is test in progress.
  */
@@ -27,6 +27,10 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <math.h>
 
 #include "Config.h"
+#include "DmaPwm.h"
+#include "KVStore.h"
+#include "LightnessCurve.h"
+#include "MCU_Sensor.h"
 #include "Mesh.h"
 #include "UARTProtocol.h"
 
@@ -38,12 +42,27 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #else
 #define PWM_OUTPUT_MIN 0u
 #endif
+
+#define LIGHTNESS_TABLE_SIZE 257u /**< Number of lightness to PWM table entries, power of two plus one */
+#define OUTPUT_TABLE_SIZE 65u     /**< Number of light output to PWM table entries of each LED string */
+
+#define MIX_RATIO_BITS 15u                   /**< Fractional bits of warm to cold mix ratio (Q15) */
+#define MIX_RATIO_ONE (1u << MIX_RATIO_BITS) /**< Mix ratio of warm only output */
+#define MIX_TEMPERATURE_UNKNOWN 0u           /**< Mix ratio was not calculated yet */
+
+#define DITHER_DUTY_MAX (1024u << LIGHTNESS_TABLE_FRACTION_BITS) /**< Higher duty is not dithered, one PWM count is not visible */
+
+typedef LightnessCurveSquare LightnessCurve; /**< Curve used to generate lightness to PWM table */
+
 /**
  * Light Lightness Controller Server configuration
  */
 #define DIMM_INTERRUPT_TIME_MS 5u /**< Dimming control interrupt interval definition [ms]. */
 #define DIMM_INTERRUPT_TIME_US (DIMM_INTERRUPT_TIME_MS * 1000)
-#define POW(a) ((a) * (a))
+#define TRANSITION_FRACTION_BITS 16u /**< Fractional bits of fixed point transition values */
+#define TRANSITION_PROGRESS_BITS 15u /**< Fractional bits of progress of profiled transitions */
+#define PROFILE_TABLE_SIZE 65u       /**< Number of normalized time to progress table entries */
+#define LIGHT_CTL_TEMP_DEFAULT ((LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN) / 2 + LIGHT_CTL_TEMP_RANGE_MIN)
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 #define ATTENTION_LIGHTNESS_ON 0xFFFF
@@ -60,15 +79,85 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define DEVICE_STARTUP_SEQ_STAGE_4_LIGHTNESS 0x0001
 #define DEVICE_STARTUP_SEQ_STAGE_OFF_LIGHTNESS 0xFFFF
 
+#define LIGHTNESS_STATE_SAVE_DELAY_MS 3000u /**< Target has to be stable that long before it is saved */
+
+#define SCHEDULE_SIZE (2u * LIGHTNESS_CHANNELS) /**< One pending lightness and temperature transition per channel */
+
+#define LOCAL_OCCUPANCY_LIGHTNESS 0xFFFFu /**< Lightness set by local occupancy sensor */
+#define LOCAL_OCCUPANCY_FADE_MS 500u      /**< Fade time of local occupancy transitions */
+#define LOCAL_OCCUPANCY_CONFIRM_MS 2000u  /**< Time for mesh to confirm lightness set by local occupancy sensor */
+
+#define DAYLIGHT_SETPOINT_DEFAULT 10000u            /**< Default ambient light setpoint in centilux */
+#define DAYLIGHT_CONTROL_INTERVAL_MS 100u           /**< Period of daylight harvesting controller */
+#define DAYLIGHT_TRIM_BITS 15u                      /**< Fractional bits of lightness trim */
+#define DAYLIGHT_TRIM_ONE (1 << DAYLIGHT_TRIM_BITS) /**< Trim leaving lightness set by mesh unchanged */
+#define DAYLIGHT_TRIM_MIN (DAYLIGHT_TRIM_ONE / 10)  /**< Lowest trim, output is never dimmed below 10 % */
+#define DAYLIGHT_GAIN_SHIFT 8u                      /**< Controller gains are in 1 / 256 of trim LSB per centilux */
+#define DAYLIGHT_KP 128                             /**< Proportional gain */
+#define DAYLIGHT_KI 64                              /**< Integral gain, per control interval */
+
+#if ENABLE_DAYLIGHT_HARVESTING
+static_assert(ENABLE_PIRALS, "Daylight harvesting requires ambient light sensor");
+#endif
+
+static_assert(TRANSITION_PROFILE <= TRANSITION_PROFILE_PERCEPTUAL, "Unknown transition profile");
+
+#if ENABLE_DMA_PWM
+static_assert(LIGHTNESS_CHANNELS == 1, "DMA playback drives warm and cold outputs of a single luminaire");
+
+#define DIMM_TICKS_PER_FILL (DMA_PWM_PERIODS * 1000u / (DMA_PWM_FREQUENCY_HZ * DIMM_INTERRUPT_TIME_MS))
+static_assert(DIMM_TICKS_PER_FILL * DMA_PWM_FREQUENCY_HZ * DIMM_INTERRUPT_TIME_MS == DMA_PWM_PERIODS * 1000u,
+              "DMA playback buffer half has to last whole number of dimming ticks");
+#endif
+
 
 struct Transition
 {
-    uint16_t target_value;
-    uint16_t start_value;
-    uint32_t start_timestamp;
-    uint32_t transition_time;
+    uint16_t            target_value;
+    uint32_t            present_value;   /**< Present value in fixed point, TRANSITION_FRACTION_BITS fractional bits */
+    int32_t             step;            /**< Linear profile: present value change per dimming interrupt */
+    uint32_t            remaining_ticks; /**< Number of dimming interrupts left to reach target value */
+    TransitionProfile_T profile;
+    uint32_t            phase;           /**< Other profiles: normalized time, 0 - UINT32_MAX */
+    uint32_t            phase_step;      /**< Other profiles: normalized time change per dimming interrupt */
+    uint16_t            start_value;     /**< Other profiles: start value, L* for perceptual profile */
+    int32_t             delta;           /**< Other profiles: target minus start value */
 };
 
+/*
+ *  Transition timing, calculated before transition is started so dimming interrupt doesn't divide
+ */
+typedef struct
+{
+    uint32_t ticks;      /**< Number of dimming interrupts to reach target value, 0 to set it at once */
+    uint32_t phase_step; /**< Normalized time change per dimming interrupt */
+    uint32_t step_ratio; /**< Dimming interrupt interval divided by transition time, 32 fractional bits */
+} TransitionTiming_T;
+
+/*
+ *  Transition waiting for its delay to expire
+ */
+typedef struct
+{
+    uint32_t            start_ms; /**< Time transition starts at, millis() time base */
+    TransitionTiming_T  timing;
+    uint16_t            target_value;
+    TransitionProfile_T profile;
+    Transition         *p_transition; /**< Channel lightness or temperature transition to be started */
+} ScheduledTransition_T;
+
+/*
+ *  Target lightness and temperature restored after reset
+ */
+typedef struct
+{
+    uint16_t lightness;
+    uint16_t temperature;
+} LightnessState_T;
+
+static_assert(LIGHTNESS_CHANNELS * sizeof(LightnessState_T) <= KV_STORE_MAX_VALUE_LEN,
+              "Lightness state of all channels has to fit in single key value store record");
+
 typedef enum
 {
     DEVICE_SEQUENCE_STAGE_1,
@@ -79,41 +168,203 @@ typedef enum
 } DeviceStartupSequence_T;
 
 
-/*
- *  Convert Lightness Actual to Lightness Linear (based on Spec Model, chapter 6.1.2.2.1)
- *
- *  @param val     Lightness Actual value
- */
-static inline uint32_t ConvertLightnessActualToLinear(uint16_t val);
-
+#if !ENABLE_DMA_PWM
 /*
  *  Dimming interrupt handler.
  */
 static void DimmInterrupt(void);
+#endif
 
 /*
- *  Calculate present transition value
+ *  Get present transition value
  *
  *  @param p_transition     Pointer to transition
  */
 static uint16_t GetPresentValue(Transition *p_transition);
 
+/*
+ *  Advance transition by one dimming interrupt
+ *
+ *  @param p_transition     Pointer to transition
+ */
+static void StepTransition(Transition *p_transition);
+
+/*
+ *  Start dimming interrupt or DMA playback if it is not running. It stops itself after output is set to final values.
+ */
+static void StartDimming(void);
+
+/*
+ *  Check if output does not have to be updated until next transition or attention change
+ *
+ *  @return     True if transitions of all channels are finished and output is not dithered
+ */
+static bool IsOutputSteady(void);
+
+/*
+ *  Find channel of Light Lightness Server instance
+ *
+ *  @param instance_idx   Instance index
+ *  @return               Channel, LIGHTNESS_CHANNELS if instance does not belong to any channel
+ */
+static size_t FindChannel(uint8_t instance_idx);
+
+/*
+ *  Get lightness to be set on output, attention overrides transitions
+ *
+ *  @param channel   Channel
+ *  @return          Lightness value
+ */
+static uint16_t GetOutputLightness(size_t channel);
+
+/*
+ *  Get warm to cold mix ratio of channel, recalculated only when present temperature changed
+ *
+ *  @param channel   Channel
+ *  @return          Warm part of output in Q15
+ */
+static uint32_t GetMixRatio(size_t channel);
+
+/*
+ *  Multiply duty by Q15 ratio in 32 bit arithmetic
+ *
+ *  @param duty      Duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits, up to 24 bits
+ *  @param ratio     Ratio in Q15, up to MIX_RATIO_ONE
+ *  @return          Scaled duty
+ */
+static uint32_t ScaleByRatio(uint32_t duty, uint32_t ratio);
+
+/*
+ *  Calculate PWM duty of warm and cold outputs
+ *
+ *  @param channel   Channel
+ *  @param val       Lightness value
+ *  @param p_warm    [out] Warm duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits
+ *  @param p_cold    [out] Cold duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits
+ */
+static void CalculateOutput(size_t channel, uint16_t val, uint32_t *p_warm, uint32_t *p_cold);
+
+#if ENABLE_DMA_PWM
+/*
+ *  Advance transitions by duration of DMA playback buffer half and fill it with duty interpolated per PWM period
+ *
+ *  @param p_duty    [out] Duty per channel and PWM period
+ *  @return          False if output is steady after this buffer half
+ */
+static bool FillPwmBuffer(uint32_t p_duty[DMA_PWM_CHANNELS][DMA_PWM_PERIODS]);
+#endif
+
 /*
  *  Calculate slope ans sets PWM output to specific lightness
  *
+ *  @param channel Channel
  *  @param val     Lightness value
  */
-static void SetLightnessOutput(uint16_t val);
+static void SetLightnessOutput(size_t channel, uint16_t val);
 
 /*
- *  Calculate new transition
+ *  Convert PWM duty with fractional bits to PWM output. With dithering enabled, fractional part of
+ *  duty below DITHER_DUTY_MAX is carried to next update (first order sigma-delta), so average output
+ *  keeps the fraction. Fraction of higher duty is dropped, so the dimming interrupt can stop.
+ *
+ *  @param duty       PWM duty with LIGHTNESS_TABLE_FRACTION_BITS fractional bits
+ *  @param p_error    Pointer to fraction carried between updates of the channel
+ *  @return           PWM output
+ */
+static uint32_t DitherOutput(uint32_t duty, uint32_t *p_error);
+
+/*
+ *  Calculate timing of transition
+ *
+ *  @param transition_time  Transition time
+ *  @return                 Transition timing
+ */
+static TransitionTiming_T CalculateTransitionTiming(uint32_t transition_time);
+
+/*
+ *  Calculate transition from present to target value, safe to call from dimming interrupt
+ *
+ *  @param present          Present value
+ *  @param target           Target value
+ *  @param p_timing         Transition timing
+ *  @param profile          Transition profile
+ *  @return                 Transition
+ */
+static Transition CalculateTransition(uint16_t                  present,
+                                      uint16_t                  target,
+                                      const TransitionTiming_T *p_timing,
+                                      TransitionProfile_T       profile);
+
+/*
+ *  Update transition
  *
  *  @param present          Present value
  *  @param target           Target value
  *  @param transition_time  Transition time
+ *  @param profile          Transition profile
+ *  @param p_transition     Pointer to transition
+ */
+static void UpdateTransition(uint16_t            present,
+                             uint16_t            target,
+                             uint32_t            transition_time,
+                             TransitionProfile_T profile,
+                             Transition         *p_transition);
+
+/*
+ *  Queue transition to be started by dimming interrupt after delay. Pending transition of the same
+ *  state is replaced, as required by Mesh Model specification for delayed messages.
+ *
+ *  @param target           Target value
+ *  @param transition_time  Transition time
+ *  @param delay            Delay in milliseconds
+ *  @param profile          Transition profile
+ *  @param p_transition     Pointer to transition
+ */
+static void ScheduleTransition(uint16_t            target,
+                               uint32_t            transition_time,
+                               uint32_t            delay,
+                               TransitionProfile_T profile,
+                               Transition         *p_transition);
+
+/*
+ *  Remove pending transition from schedule. Must be called with interrupts disabled.
+ *
  *  @param p_transition     Pointer to transition
  */
-static void UpdateTransition(uint16_t present, uint16_t target, uint32_t transition_time, Transition *p_transition);
+static void CancelScheduledTransition(Transition *p_transition);
+
+/*
+ *  Start scheduled transitions whose delay expired, called from dimming interrupt
+ */
+static void StartScheduledTransitions(void);
+
+#if ENABLE_LOCAL_OCCUPANCY
+/*
+ *  Get target of pending transition. Must be called with interrupts disabled.
+ *
+ *  @param p_transition     Pointer to transition
+ *  @param p_target         [out] Target value of scheduled transition
+ *  @return                 True if transition is scheduled
+ */
+static bool GetScheduledTarget(Transition *p_transition, uint16_t *p_target);
+
+/*
+ *  Fade up channels on occupancy detected by local sensor, called from dimming interrupt
+ */
+static void StartLocalOccupancy(void);
+
+/*
+ *  Return to lightness set by mesh if it did not confirm local occupancy in time
+ */
+static void RevertLocalOccupancyIfNeeded(void);
+#endif
+
+#if ENABLE_DAYLIGHT_HARVESTING
+/*
+ *  Update lightness trim to hold ambient light setpoint, PI controller run every DAYLIGHT_CONTROL_INTERVAL_MS
+ */
+static void ControlDaylightIfNeeded(void);
+#endif
 
 /*
  *  Calculate current stage on Startup Sequence
@@ -122,106 +373,602 @@ static void UpdateTransition(uint16_t present, uint16_t target, uint32_t transit
  */
 static DeviceStartupSequence_T GetStartupSequenceStage(unsigned long time_since_sequence_start);
 
-static Transition Light = {
-    .target_value    = 0,
-    .start_value     = 0,
-    .start_timestamp = 0,
-    .transition_time = 0,
-};
+/*
+ *  Apply lightness and temperature saved before reset
+ */
+static void RestoreLightnessState(void);
 
-static Transition Temperature = {
-    .target_value    = (LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN) / 2 + LIGHT_CTL_TEMP_RANGE_MIN,
-    .start_value     = LIGHT_CTL_TEMP_RANGE_MIN,
-    .start_timestamp = 0,
-    .transition_time = 0,
-};
+/*
+ *  Save target lightness and temperature once they are stable
+ */
+static void SaveLightnessStateIfNeeded(void);
 
-static bool          IsEnabled                       = false;
-static bool          CTLSupport                      = false;
-static uint8_t       LightLightnessServerIdx         = INSTANCE_INDEX_UNKNOWN;
-static volatile bool AttentionLedState               = false;
-static bool          UnprovisionedSequenceEnableFlag = false;
+/*
+ *  Get start value for transition requested by mesh. Until first state is received from mesh
+ *  after reset, transition starts from restored output instead of value reported by mesh.
+ *
+ *  @param channel          Channel
+ *  @param present          Present value reported by mesh
+ *  @param p_transition     Pointer to transition
+ */
+static uint16_t GetTransitionStartValue(size_t channel, uint16_t present, Transition *p_transition);
 
+#if ENABLE_OUTPUT_CALIBRATION
+/*
+ *  Lightness is converted to light output first, warm and cold parts are then converted to PWM duty
+ *  with calibration table of each LED string.
+ */
+static constexpr LightnessTable<LightnessCurve, LIGHTNESS_TABLE_SIZE, 0u, UINT16_MAX>                PwmTable{};
+static constexpr LightnessTable<OutputCurveWarm, OUTPUT_TABLE_SIZE, PWM_OUTPUT_MIN, PWM_OUTPUT_MAX> WarmTable{};
+static constexpr LightnessTable<OutputCurveCold, OUTPUT_TABLE_SIZE, PWM_OUTPUT_MIN, PWM_OUTPUT_MAX> ColdTable{};
+#else
+static constexpr LightnessTable<LightnessCurve, LIGHTNESS_TABLE_SIZE, PWM_OUTPUT_MIN, PWM_OUTPUT_MAX> PwmTable{};
+#endif
 
-static inline uint32_t ConvertLightnessActualToLinear(uint16_t val)
+/*
+ *  Transition profile tables, progress and L* are scaled to 0 - UINT16_MAX
+ */
+#if TRANSITION_PROFILE == TRANSITION_PROFILE_EASE_IN_OUT
+static constexpr LightnessTable<TransitionCurveEaseInOut, PROFILE_TABLE_SIZE, 0u, UINT16_MAX> EaseTable{};
+#endif
+#if TRANSITION_PROFILE == TRANSITION_PROFILE_PERCEPTUAL
+static constexpr LightnessTable<TransitionCurveFromLStar<LightnessCurve>, LIGHTNESS_TABLE_SIZE, 0u, UINT16_MAX> FromLStarTable{};
+#endif
+
+/*
+ *  Channel table, one entry per luminaire
+ */
+static const uint8_t PinWarm[LIGHTNESS_CHANNELS] = LIGHTNESS_PINS_WARM;
+static const uint8_t PinCold[LIGHTNESS_CHANNELS] = LIGHTNESS_PINS_COLD;
+static uint8_t       ServerIdx[LIGHTNESS_CHANNELS];
+static Transition    Light[LIGHTNESS_CHANNELS];
+static Transition    Temperature[LIGHTNESS_CHANNELS];
+static uint32_t      DitherErrorWarm[LIGHTNESS_CHANNELS];
+static uint32_t      DitherErrorCold[LIGHTNESS_CHANNELS];
+static bool          IsStateRestored[LIGHTNESS_CHANNELS]; /**< Output shows restored state not yet confirmed by mesh */
+static uint16_t      MixTemperature[LIGHTNESS_CHANNELS];  /**< Temperature MixRatio was calculated for */
+static uint16_t      MixRatio[LIGHTNESS_CHANNELS];        /**< Warm part of output in Q15 */
+#if ENABLE_LOCAL_OCCUPANCY
+static volatile bool     IsLocalOverride[LIGHTNESS_CHANNELS]; /**< Lightness set by local occupancy, not by mesh */
+static volatile uint16_t MeshTarget[LIGHTNESS_CHANNELS];      /**< Target lightness set by mesh before local occupancy */
+static volatile uint32_t LocalOverrideTimestamp[LIGHTNESS_CHANNELS];
+static volatile bool     IsOccupancyPending = false; /**< Local sensor detected occupancy, not yet applied */
+static TransitionTiming_T LocalOccupancyTiming; /**< Timing of local occupancy fade, used in dimming interrupt */
+#endif
+#if ENABLE_DAYLIGHT_HARVESTING
+static volatile uint16_t DaylightTrim      = DAYLIGHT_TRIM_ONE; /**< Lightness multiplier of provisioned channels */
+static int32_t           DaylightIntegral  = DAYLIGHT_TRIM_ONE; /**< Integral part of trim */
+static uint32_t          DaylightSetpoint  = DAYLIGHT_SETPOINT_DEFAULT;
+static uint32_t          DaylightTimestamp = 0;
+#endif
+
+static bool              IsEnabled                       = false;
+static bool              CTLSupport                      = false;
+static volatile bool     AttentionLedState               = false;
+static volatile uint16_t AttentionLightness              = 0;
+static bool              UnprovisionedSequenceEnableFlag = false;
+static bool              IsStateChanged                  = false; /**< Target changed since last save */
+static uint32_t          StateChangeTimestamp            = 0;
+static volatile bool     IsDithering                     = false; /**< Output has fractional part to be dithered */
+
+static ScheduledTransition_T Schedule[SCHEDULE_SIZE]; /**< Pending transitions ordered by start time */
+static volatile size_t       ScheduleLen = 0;
+#if ENABLE_DMA_PWM
+static uint32_t FillEndWarm = 0; /**< Warm duty at the end of last filled buffer half */
+static uint32_t FillEndCold = 0; /**< Cold duty at the end of last filled buffer half */
+#else
+static volatile bool IsDimmingActive = false; /**< Dimming interrupt is running */
+#endif
+
+
+#if !ENABLE_DMA_PWM
+static void DimmInterrupt(void)
 {
-    return (LIGHTNESS_MAX * POW((val * UINT8_MAX) / LIGHTNESS_MAX)) / UINT16_MAX;
+    StartScheduledTransitions();
+#if ENABLE_LOCAL_OCCUPANCY
+    StartLocalOccupancy();
+#endif
+
+    IsDithering = false;
+
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        StepTransition(&Light[channel]);
+        StepTransition(&Temperature[channel]);
+
+        SetLightnessOutput(channel, GetOutputLightness(channel));
+    }
+
+    if (IsOutputSteady())
+    {
+        Timer1.stop();
+        IsDimmingActive = false;
+    }
 }
+#endif
 
-static void DimmInterrupt(void)
+#if ENABLE_DMA_PWM
+static bool FillPwmBuffer(uint32_t p_duty[DMA_PWM_CHANNELS][DMA_PWM_PERIODS])
+{
+    StartScheduledTransitions();
+#if ENABLE_LOCAL_OCCUPANCY
+    StartLocalOccupancy();
+#endif
+
+    for (size_t tick = 0; tick < DIMM_TICKS_PER_FILL; tick++)
+    {
+        StepTransition(&Light[0]);
+        StepTransition(&Temperature[0]);
+    }
+
+    uint32_t warm;
+    uint32_t cold;
+    CalculateOutput(0, GetOutputLightness(0), &warm, &cold);
+
+    IsDithering = false;
+
+    for (size_t period = 0; period < DMA_PWM_PERIODS; period++)
+    {
+        uint32_t warm_period = FillEndWarm + (int32_t)(warm - FillEndWarm) * (int32_t)(period + 1) / DMA_PWM_PERIODS;
+        uint32_t cold_period = FillEndCold + (int32_t)(cold - FillEndCold) * (int32_t)(period + 1) / DMA_PWM_PERIODS;
+
+        p_duty[DMA_PWM_CHANNEL_WARM][period] = DitherOutput(warm_period, &DitherErrorWarm[0]);
+        p_duty[DMA_PWM_CHANNEL_COLD][period] = DitherOutput(cold_period, &DitherErrorCold[0]);
+    }
+
+    FillEndWarm = warm;
+    FillEndCold = cold;
+
+    return !IsOutputSteady();
+}
+#endif
+
+static bool IsOutputSteady(void)
 {
-    if (!AttentionLedState)
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
     {
-        SetLightnessOutput(GetPresentValue(&Light));
+        if (Light[channel].remaining_ticks != 0 || Temperature[channel].remaining_ticks != 0)
+        {
+            return false;
+        }
     }
+
+    return ScheduleLen == 0 && !IsDithering;
 }
 
-static uint16_t GetPresentValue(Transition *p_transition)
+static size_t FindChannel(uint8_t instance_idx)
 {
-    uint32_t time       = millis();
-    uint32_t delta_time = time - p_transition->start_timestamp;
+    size_t channel = 0;
+    while (channel < LIGHTNESS_CHANNELS && ServerIdx[channel] != instance_idx)
+    {
+        channel++;
+    }
+    return channel;
+}
 
-    if (delta_time > p_transition->transition_time)
+static uint16_t GetOutputLightness(size_t channel)
+{
+    if (AttentionLedState)
     {
-        p_transition->start_value = p_transition->target_value;
-        return p_transition->start_value;
+        return AttentionLightness;
     }
 
-    int32_t delta_transition = ((int64_t)p_transition->target_value - p_transition->start_value) * delta_time /
-                               p_transition->transition_time;
+    uint16_t lightness = GetPresentValue(&Light[channel]);
+#if ENABLE_DAYLIGHT_HARVESTING
+    if (ServerIdx[channel] != INSTANCE_INDEX_UNKNOWN)
+    {
+        lightness = ((uint32_t)lightness * DaylightTrim) >> DAYLIGHT_TRIM_BITS;
+    }
+#endif
+    return lightness;
+}
 
-    return p_transition->start_value + delta_transition;
+static uint16_t GetPresentValue(Transition *p_transition)
+{
+    return p_transition->present_value >> TRANSITION_FRACTION_BITS;
 }
 
-static void SetLightnessOutput(uint16_t val)
+static void StepTransition(Transition *p_transition)
 {
-    const uint32_t coefficient = ((uint32_t)(PWM_OUTPUT_MAX - PWM_OUTPUT_MIN) * UINT16_MAX) /
-                                 (LIGHTNESS_MAX - LIGHTNESS_MIN);
-    uint32_t pwm_out;
+    if (p_transition->remaining_ticks == 0)
+    {
+        return;
+    }
+
+    p_transition->remaining_ticks--;
 
-    if (val == 0)
+    if (p_transition->remaining_ticks == 0)
     {
-        pwm_out = 0;
+        // Land exactly on target, regardless of step rounding
+        p_transition->present_value = (uint32_t)p_transition->target_value << TRANSITION_FRACTION_BITS;
+        return;
     }
-    else
+
+    if (p_transition->profile == TRANSITION_PROFILE_LINEAR)
     {
-        // calc value to PWM OUTPUT
-        pwm_out = ConvertLightnessActualToLinear(val);
-        // Calculate value depend of 0-10 V
-        pwm_out = ((coefficient * (pwm_out - LIGHTNESS_MIN)) / UINT16_MAX) + PWM_OUTPUT_MIN;
+        p_transition->present_value += p_transition->step;
+        return;
     }
 
+    // Cost is constant for all profiles: one or two table lookups and one multiplication
+    p_transition->phase += p_transition->phase_step;
+
+    uint32_t progress = p_transition->phase >> 16;
+#if TRANSITION_PROFILE == TRANSITION_PROFILE_EASE_IN_OUT
+    progress = EaseTable.Lookup(progress) >> LIGHTNESS_TABLE_FRACTION_BITS;
+#endif
+
+    // Delta takes 17 bits with sign, progress is reduced to 15 bits so the product fits in 32 bits
+    int32_t  change = (p_transition->delta * (int32_t)(progress >> 1)) >> TRANSITION_PROGRESS_BITS;
+    uint32_t value  = p_transition->start_value + change;
+#if TRANSITION_PROFILE == TRANSITION_PROFILE_PERCEPTUAL
+    value = FromLStarTable.Lookup(value) >> LIGHTNESS_TABLE_FRACTION_BITS;
+#endif
+
+    p_transition->present_value = value << TRANSITION_FRACTION_BITS;
+}
+
+static void SetLightnessOutput(size_t channel, uint16_t val)
+{
+    uint32_t warm;
+    uint32_t cold;
+    CalculateOutput(channel, val, &warm, &cold);
+
+    analogWrite(PinWarm[channel], DitherOutput(warm, &DitherErrorWarm[channel]));
+    analogWrite(PinCold[channel], DitherOutput(cold, &DitherErrorCold[channel]));
+}
+
+static void CalculateOutput(size_t channel, uint16_t val, uint32_t *p_warm, uint32_t *p_cold)
+{
+    uint32_t pwm_out = PwmTable.Lookup(val);
+    uint32_t warm    = 0;
+    uint32_t cold    = pwm_out;
+
     if (CTLSupport)
     {
-        uint64_t warm;
-        uint64_t cold;
+        warm = ScaleByRatio(pwm_out, GetMixRatio(channel));
+        cold = ScaleByRatio(pwm_out, MIX_RATIO_ONE - GetMixRatio(channel));
+    }
 
-        uint16_t temperature = GetPresentValue(&Temperature);
+#if ENABLE_OUTPUT_CALIBRATION
+    warm = WarmTable.Lookup(warm >> LIGHTNESS_TABLE_FRACTION_BITS);
+    cold = ColdTable.Lookup(cold >> LIGHTNESS_TABLE_FRACTION_BITS);
+#endif
 
-        cold = (LIGHT_CTL_TEMP_RANGE_MAX - temperature) * pwm_out;
-        cold /= LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN;
+    *p_warm = warm;
+    *p_cold = cold;
+}
 
-        warm = (temperature - LIGHT_CTL_TEMP_RANGE_MIN) * pwm_out;
-        warm /= LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN;
+static uint32_t GetMixRatio(size_t channel)
+{
+    uint16_t temperature = GetPresentValue(&Temperature[channel]);
 
-        analogWrite(PIN_PWM_WARM, warm);
-        analogWrite(PIN_PWM_COLD, cold);
+    if (temperature != MixTemperature[channel])
+    {
+        uint32_t clamped = temperature;
+        if (clamped < LIGHT_CTL_TEMP_RANGE_MIN)
+            clamped = LIGHT_CTL_TEMP_RANGE_MIN;
+        if (clamped > LIGHT_CTL_TEMP_RANGE_MAX)
+            clamped = LIGHT_CTL_TEMP_RANGE_MAX;
+
+        const uint32_t range = LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN;
+
+        MixRatio[channel]       = (((clamped - LIGHT_CTL_TEMP_RANGE_MIN) << MIX_RATIO_BITS) + range / 2) / range;
+        MixTemperature[channel] = temperature;
+    }
+
+    return MixRatio[channel];
+}
+
+static uint32_t ScaleByRatio(uint32_t duty, uint32_t ratio)
+{
+    // Split duty so both products fit in 32 bits, Cortex-M0+ has no 32x32 -> 64 bit multiplication
+    uint32_t high = (duty >> 8) * ratio;
+    uint32_t low  = (duty & 0xFFu) * ratio;
+
+    return (high >> (MIX_RATIO_BITS - 8)) + (low >> MIX_RATIO_BITS);
+}
+
+static uint32_t DitherOutput(uint32_t duty, uint32_t *p_error)
+{
+#if ENABLE_DITHERING
+    const uint32_t fraction_mask = (1u << LIGHTNESS_TABLE_FRACTION_BITS) - 1;
+
+    if (duty >= DITHER_DUTY_MAX)
+    {
+        *p_error = 0;
+        return duty >> LIGHTNESS_TABLE_FRACTION_BITS;
+    }
+
+    if ((duty & fraction_mask) != 0)
+    {
+        IsDithering = true;
+    }
+
+    duty += *p_error;
+    *p_error = duty & fraction_mask;
+#endif
+
+    return duty >> LIGHTNESS_TABLE_FRACTION_BITS;
+}
+
+static TransitionTiming_T CalculateTransitionTiming(uint32_t transition_time)
+{
+    TransitionTiming_T timing = {};
+    uint32_t           ticks  = (transition_time + DIMM_INTERRUPT_TIME_MS - 1) / DIMM_INTERRUPT_TIME_MS;
+
+    if (ticks > 1)
+    {
+        // Last tick lands on target, so transition time is kept even if it is not a multiple of the
+        // dimming interrupt interval.
+        uint32_t time = max(transition_time, 2 * DIMM_INTERRUPT_TIME_MS);
+
+        timing.ticks      = ticks;
+        timing.phase_step = UINT32_MAX / ticks;
+        timing.step_ratio = ((uint64_t)DIMM_INTERRUPT_TIME_MS << 32) / time;
+    }
+
+    return timing;
+}
+
+static Transition CalculateTransition(uint16_t                  present,
+                                      uint16_t                  target,
+                                      const TransitionTiming_T *p_timing,
+                                      TransitionProfile_T       profile)
+{
+    uint32_t   ticks = p_timing->ticks;
+    int32_t    step  = 0;
+    Transition transition = {};
+
+    if (ticks != 0 && profile != TRANSITION_PROFILE_LINEAR)
+    {
+        uint16_t start = present;
+        uint16_t end   = target;
+#if TRANSITION_PROFILE == TRANSITION_PROFILE_PERCEPTUAL
+        // L* is found in the table used by dimming interrupt, so transition starts and ends without a jump
+        start = FromLStarTable.ReverseLookup((uint32_t)present << LIGHTNESS_TABLE_FRACTION_BITS);
+        end   = FromLStarTable.ReverseLookup((uint32_t)target << LIGHTNESS_TABLE_FRACTION_BITS);
+#endif
+
+        transition.phase       = 0;
+        transition.phase_step  = p_timing->phase_step;
+        transition.start_value = start;
+        transition.delta       = (int32_t)end - start;
+    }
+    else if (ticks != 0)
+    {
+        // Step is rounded towards zero, so present value never passes the target before the last tick
+        int32_t  delta    = (int32_t)target - present;
+        uint64_t distance = (uint64_t)abs(delta) << TRANSITION_FRACTION_BITS;
+        int32_t  size     = (distance * p_timing->step_ratio) >> 32;
+
+        step = (delta < 0) ? -size : size;
     }
     else
     {
-        analogWrite(PIN_PWM_COLD, pwm_out);
-        analogWrite(PIN_PWM_WARM, 0);
+        present = target;
+    }
+
+    transition.target_value    = target;
+    transition.present_value   = (uint32_t)present << TRANSITION_FRACTION_BITS;
+    transition.step            = step;
+    transition.remaining_ticks = ticks;
+    transition.profile         = profile;
+    return transition;
+}
+
+static void UpdateTransition(uint16_t            present,
+                             uint16_t            target,
+                             uint32_t            transition_time,
+                             TransitionProfile_T profile,
+                             Transition         *p_transition)
+{
+    TransitionTiming_T timing     = CalculateTransitionTiming(transition_time);
+    Transition         transition = CalculateTransition(present, target, &timing, profile);
+
+    noInterrupts();
+    CancelScheduledTransition(p_transition);
+    *p_transition = transition;
+    interrupts();
+
+    StartDimming();
+}
+
+static void ScheduleTransition(uint16_t            target,
+                               uint32_t            transition_time,
+                               uint32_t            delay,
+                               TransitionProfile_T profile,
+                               Transition         *p_transition)
+{
+    uint32_t           start_ms = millis() + delay;
+    TransitionTiming_T timing   = CalculateTransitionTiming(transition_time);
+
+    noInterrupts();
+    CancelScheduledTransition(p_transition);
+
+    // Keep schedule ordered by start time, entries with equal start time keep arrival order
+    size_t index = ScheduleLen;
+    while (index > 0 && (int32_t)(Schedule[index - 1].start_ms - start_ms) > 0)
+    {
+        Schedule[index] = Schedule[index - 1];
+        index--;
+    }
+
+    Schedule[index].start_ms     = start_ms;
+    Schedule[index].timing       = timing;
+    Schedule[index].target_value = target;
+    Schedule[index].profile      = profile;
+    Schedule[index].p_transition = p_transition;
+    ScheduleLen                  = ScheduleLen + 1;
+    interrupts();
+
+    StartDimming();
+}
+
+static void CancelScheduledTransition(Transition *p_transition)
+{
+    for (size_t index = 0; index < ScheduleLen; index++)
+    {
+        if (Schedule[index].p_transition == p_transition)
+        {
+            for (; index + 1 < ScheduleLen; index++)
+            {
+                Schedule[index] = Schedule[index + 1];
+            }
+            ScheduleLen = ScheduleLen - 1;
+            return;
+        }
+    }
+}
+
+static void StartScheduledTransitions(void)
+{
+    uint32_t now     = millis();
+    size_t   started = 0;
+
+    while (started < ScheduleLen && (int32_t)(now - Schedule[started].start_ms) >= 0)
+    {
+        ScheduledTransition_T *p_entry = &Schedule[started];
+
+        *p_entry->p_transition = CalculateTransition(GetPresentValue(p_entry->p_transition),
+                                                     p_entry->target_value,
+                                                     &p_entry->timing,
+                                                     p_entry->profile);
+        started++;
+    }
+
+    if (started == 0)
+        return;
+
+    for (size_t index = started; index < ScheduleLen; index++)
+    {
+        Schedule[index - started] = Schedule[index];
+    }
+    ScheduleLen = ScheduleLen - started;
+}
+
+#if ENABLE_LOCAL_OCCUPANCY
+static bool GetScheduledTarget(Transition *p_transition, uint16_t *p_target)
+{
+    for (size_t index = 0; index < ScheduleLen; index++)
+    {
+        if (Schedule[index].p_transition == p_transition)
+        {
+            *p_target = Schedule[index].target_value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void StartLocalOccupancy(void)
+{
+    if (!IsOccupancyPending)
+        return;
+
+    IsOccupancyPending = false;
+
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        // Only light up provisioned channels, mesh keeps control over dimming
+        if (ServerIdx[channel] == INSTANCE_INDEX_UNKNOWN)
+            continue;
+
+        // Pending scheduled transition would dim the channel, so it is taken over as well and its target
+        // is restored if mesh doesn't confirm.
+        if (!IsLocalOverride[channel])
+        {
+            uint16_t mesh_target  = Light[channel].target_value;
+            bool     is_scheduled = GetScheduledTarget(&Light[channel], &mesh_target);
+            if (!is_scheduled && mesh_target >= LOCAL_OCCUPANCY_LIGHTNESS)
+                continue;
+
+            MeshTarget[channel]      = mesh_target;
+            IsLocalOverride[channel] = true;
+        }
+
+        // Repeated trigger keeps channel lit until mesh confirms, also after local fade has finished
+        LocalOverrideTimestamp[channel] = millis();
+        CancelScheduledTransition(&Light[channel]);
+
+        if (Light[channel].target_value >= LOCAL_OCCUPANCY_LIGHTNESS)
+            continue;
+
+        Light[channel] = CalculateTransition(
+            GetPresentValue(&Light[channel]), LOCAL_OCCUPANCY_LIGHTNESS, &LocalOccupancyTiming, TRANSITION_PROFILE_LINEAR);
+    }
+}
+
+static void RevertLocalOccupancyIfNeeded(void)
+{
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        noInterrupts();
+        bool is_expired = IsLocalOverride[channel] &&
+                          millis() - LocalOverrideTimestamp[channel] >= LOCAL_OCCUPANCY_CONFIRM_MS;
+        if (is_expired)
+        {
+            IsLocalOverride[channel] = false;
+        }
+        interrupts();
+
+        if (is_expired)
+        {
+            INFO("Local occupancy %d not confirmed by mesh\n", channel);
+            UpdateTransition(GetPresentValue(&Light[channel]),
+                             MeshTarget[channel],
+                             LOCAL_OCCUPANCY_FADE_MS,
+                             TRANSITION_PROFILE_LINEAR,
+                             &Light[channel]);
+        }
+    }
+}
+#endif
+
+#if ENABLE_DAYLIGHT_HARVESTING
+static void ControlDaylightIfNeeded(void)
+{
+    if (millis() - DaylightTimestamp < DAYLIGHT_CONTROL_INTERVAL_MS)
+        return;
+
+    DaylightTimestamp = millis();
+
+    int32_t trim = DAYLIGHT_TRIM_ONE;
+
+    if (DaylightSetpoint != 0)
+    {
+        // Positive error means too little light, so trim goes up towards lightness set by mesh
+        int32_t error = (int32_t)DaylightSetpoint - (int32_t)ReadAmbientLightCentilux();
+
+        DaylightIntegral += (error * DAYLIGHT_KI) >> DAYLIGHT_GAIN_SHIFT;
+        DaylightIntegral = constrain(DaylightIntegral, DAYLIGHT_TRIM_MIN, DAYLIGHT_TRIM_ONE);
+
+        trim = DaylightIntegral + ((error * DAYLIGHT_KP) >> DAYLIGHT_GAIN_SHIFT);
+        trim = constrain(trim, DAYLIGHT_TRIM_MIN, DAYLIGHT_TRIM_ONE);
+    }
+
+    if (trim != DaylightTrim)
+    {
+        DaylightTrim = trim;
+        StartDimming();
     }
 }
+#endif
 
-static void UpdateTransition(uint16_t present, uint16_t target, uint32_t transition_time, Transition *p_transition)
+static void StartDimming(void)
 {
+#if ENABLE_DMA_PWM
+    DmaPwm_Start();
+#else
     noInterrupts();
-    p_transition->start_value     = present;
-    p_transition->target_value    = target;
-    p_transition->transition_time = transition_time;
-    p_transition->start_timestamp = millis();
+    if (!IsDimmingActive)
+    {
+        IsDimmingActive = true;
+        Timer1.start();
+    }
     interrupts();
+#endif
 }
 
 static DeviceStartupSequence_T GetStartupSequenceStage(unsigned long time_since_sequence_start)
@@ -260,7 +1007,10 @@ static void PerformStartupSequenceIfNeeded(void)
         UnprovisionedSequenceEnableFlag = false;
         present_startup_sequence_stage  = DEVICE_SEQUENCE_STAGE_1;
 
-        ProcessTargetLightness(0, startup_sequence_lightness[present_startup_sequence_stage], 0);
+        for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+        {
+            UpdateTransition(0, startup_sequence_lightness[present_startup_sequence_stage], 0, TRANSITION_PROFILE_LINEAR, &Light[channel]);
+        }
     }
 
     unsigned long           sequence_duration = millis() - sequence_start;
@@ -270,16 +1020,86 @@ static void PerformStartupSequenceIfNeeded(void)
         present_startup_sequence_stage != calculated_stage)
     {
         present_startup_sequence_stage = calculated_stage;
-        ProcessTargetLightness(0, startup_sequence_lightness[present_startup_sequence_stage], 0);
+
+        for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+        {
+            UpdateTransition(0, startup_sequence_lightness[present_startup_sequence_stage], 0, TRANSITION_PROFILE_LINEAR, &Light[channel]);
+        }
     }
 }
 
+static void RestoreLightnessState(void)
+{
+    LightnessState_T state[LIGHTNESS_CHANNELS];
+    if (KVStore_Read(KV_KEY_LIGHTNESS_STATE, state, sizeof(state)) != KV_STORE_SUCCESS)
+    {
+        return;
+    }
+
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        INFO("Lightness %d restored: %d, temperature %d\n", channel, state[channel].lightness, state[channel].temperature);
 
-void SetLightnessServerIdx(uint8_t idx)
+        UpdateTransition(state[channel].lightness, state[channel].lightness, 0, TRANSITION_PROFILE_LINEAR, &Light[channel]);
+        if (state[channel].temperature >= LIGHT_CTL_TEMP_RANGE_MIN &&
+            state[channel].temperature <= LIGHT_CTL_TEMP_RANGE_MAX)
+        {
+            UpdateTransition(
+                state[channel].temperature, state[channel].temperature, 0, TRANSITION_PROFILE_LINEAR, &Temperature[channel]);
+        }
+        IsStateRestored[channel] = true;
+    }
+}
+
+static void SaveLightnessStateIfNeeded(void)
 {
-    if (!IsEnabled)
+    if (!IsStateChanged || millis() - StateChangeTimestamp < LIGHTNESS_STATE_SAVE_DELAY_MS)
+    {
+        return;
+    }
+
+    LightnessState_T state[LIGHTNESS_CHANNELS];
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        state[channel].lightness   = Light[channel].target_value;
+#if ENABLE_LOCAL_OCCUPANCY
+        if (IsLocalOverride[channel])
+        {
+            state[channel].lightness = MeshTarget[channel];
+        }
+#endif
+        state[channel].temperature = Temperature[channel].target_value;
+    }
+
+    // Store skips the write if the value has not changed since last save
+    KVStore_Write(KV_KEY_LIGHTNESS_STATE, state, sizeof(state));
+    IsStateChanged = false;
+}
+
+static uint16_t GetTransitionStartValue(size_t channel, uint16_t present, Transition *p_transition)
+{
+#if ENABLE_LOCAL_OCCUPANCY
+    // Mesh is not aware of local occupancy yet, its present value is older than output
+    if (p_transition == &Light[channel] && IsLocalOverride[channel])
+    {
+        return GetPresentValue(p_transition);
+    }
+#endif
+
+    if (!IsStateRestored[channel])
+    {
+        return present;
+    }
+
+    return GetPresentValue(p_transition);
+}
+
+
+void SetLightnessServerIdx(uint8_t channel, uint8_t idx)
+{
+    if (!IsEnabled || channel >= LIGHTNESS_CHANNELS)
         return;
-    LightLightnessServerIdx = idx;
+    ServerIdx[channel] = idx;
 }
 
 void SetLightCTLSupport(bool support)
@@ -289,9 +1109,11 @@ void SetLightCTLSupport(bool support)
     CTLSupport = support;
 }
 
-uint8_t GetLightnessServerIdx(void)
+uint8_t GetLightnessServerIdx(uint8_t channel)
 {
-    return LightLightnessServerIdx;
+    if (channel >= LIGHTNESS_CHANNELS)
+        return INSTANCE_INDEX_UNKNOWN;
+    return ServerIdx[channel];
 }
 
 void IndicateAttentionLightness(bool attention_state, bool led_state)
@@ -299,42 +1121,109 @@ void IndicateAttentionLightness(bool attention_state, bool led_state)
     if (!IsEnabled)
         return;
 
-    if (attention_state)
+    uint16_t led_lightness = led_state ? ATTENTION_LIGHTNESS_ON : ATTENTION_LIGHTNESS_OFF;
+
+    if (attention_state == AttentionLedState && (!attention_state || AttentionLightness == led_lightness))
     {
-        uint16_t led_lightness = led_state ? ATTENTION_LIGHTNESS_ON : ATTENTION_LIGHTNESS_OFF;
-        SetLightnessOutput(led_lightness);
+        return;
     }
-    AttentionLedState = attention_state;
+
+    // Output is updated by dimming interrupt, after attention it restores output set by transitions
+    AttentionLightness = led_lightness;
+    AttentionLedState  = attention_state;
+    StartDimming();
 }
 
-void ProcessTargetLightness(uint16_t present, uint16_t target, uint32_t transition_time)
+void ProcessTargetLightness(uint8_t  instance_idx,
+                            uint16_t present,
+                            uint16_t target,
+                            uint32_t transition_time,
+                            uint32_t delay)
 {
     if (!IsEnabled)
         return;
 
-    INFO("Lightness: %d -> %d, transition_time %d\n", present, target, transition_time);
+    size_t channel = FindChannel(instance_idx);
+    if (channel == LIGHTNESS_CHANNELS)
+        return;
+
+    INFO("Lightness %d: %d -> %d, transition_time %d, delay %d\n", channel, present, target, transition_time, delay);
+
+    Transition         *p_transition = &Light[channel];
+    TransitionProfile_T profile      = TRANSITION_PROFILE;
+    if (delay == 0)
+        UpdateTransition(GetTransitionStartValue(channel, present, p_transition), target, transition_time, profile, p_transition);
+    else
+        ScheduleTransition(target, transition_time, delay, profile, p_transition);
 
-    UpdateTransition(present, target, transition_time, &Light);
+    IsStateRestored[channel] = false;
+    IsStateChanged           = true;
+    StateChangeTimestamp     = millis();
+#if ENABLE_LOCAL_OCCUPANCY
+    IsLocalOverride[channel] = false;
+#endif
 }
 
-void ProcessTargetLightnessTemp(uint16_t present, uint16_t target, uint32_t transition_time)
+void ProcessTargetLightnessTemp(uint8_t  instance_idx,
+                                uint16_t present,
+                                uint16_t target,
+                                uint32_t transition_time,
+                                uint32_t delay)
 {
     if (!IsEnabled)
         return;
 
-    INFO("Temperature: %d-> %d, transition_time %d\n", present, target, transition_time);
+    size_t channel = FindChannel(instance_idx);
+    if (channel == LIGHTNESS_CHANNELS)
+        return;
+
+    INFO("Temperature %d: %d-> %d, transition_time %d, delay %d\n", channel, present, target, transition_time, delay);
 
-    UpdateTransition(present, target, transition_time, &Temperature);
+    // L* applies to lightness only, temperature changes linearly instead
+    Transition         *p_transition = &Temperature[channel];
+    TransitionProfile_T profile      = TRANSITION_PROFILE;
+    if (profile == TRANSITION_PROFILE_PERCEPTUAL)
+        profile = TRANSITION_PROFILE_LINEAR;
+
+    if (delay == 0)
+        UpdateTransition(GetTransitionStartValue(channel, present, p_transition), target, transition_time, profile, p_transition);
+    else
+        ScheduleTransition(target, transition_time, delay, profile, p_transition);
+
+    IsStateChanged       = true;
+    StateChangeTimestamp = millis();
 }
 
 void SetupLightnessServer(void)
 {
     IsEnabled = true;
-    pinMode(PIN_PWM_WARM, OUTPUT);
-    pinMode(PIN_PWM_COLD, OUTPUT);
+
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        ServerIdx[channel]                 = INSTANCE_INDEX_UNKNOWN;
+        MixTemperature[channel]            = MIX_TEMPERATURE_UNKNOWN;
+        Temperature[channel].target_value  = LIGHT_CTL_TEMP_DEFAULT;
+        Temperature[channel].present_value = (uint32_t)LIGHT_CTL_TEMP_DEFAULT << TRANSITION_FRACTION_BITS;
+
+        pinMode(PinWarm[channel], OUTPUT);
+        pinMode(PinCold[channel], OUTPUT);
+    }
+#if ENABLE_LOCAL_OCCUPANCY
+    LocalOccupancyTiming = CalculateTransitionTiming(LOCAL_OCCUPANCY_FADE_MS);
+#endif
+
     analogWriteResolution(PWM_RESOLUTION);
+#if ENABLE_DMA_PWM
+    if (!DmaPwm_Setup(PinWarm[0], PinCold[0], FillPwmBuffer))
+    {
+        INFO("PWM pins not supported by DMA playback.\n");
+    }
+#else
     Timer1.initialize(DIMM_INTERRUPT_TIME_US);
+    IsDimmingActive = true;
     Timer1.attachInterrupt(DimmInterrupt);
+#endif
+    RestoreLightnessState();
 }
 
 void LoopLightnessServer(void)
@@ -343,6 +1232,13 @@ void LoopLightnessServer(void)
         return;
 
     PerformStartupSequenceIfNeeded();
+    SaveLightnessStateIfNeeded();
+#if ENABLE_LOCAL_OCCUPANCY
+    RevertLocalOccupancyIfNeeded();
+#endif
+#if ENABLE_DAYLIGHT_HARVESTING
+    ControlDaylightIfNeeded();
+#endif
 }
 
 void EnableStartupSequence(void)
@@ -353,10 +1249,41 @@ void EnableStartupSequence(void)
     UnprovisionedSequenceEnableFlag = true;
 }
 
+void SetDaylightSetpoint(uint32_t centilux)
+{
+#if ENABLE_DAYLIGHT_HARVESTING
+    INFO("Daylight setpoint %d\n", centilux);
+    DaylightSetpoint = centilux;
+#endif
+}
+
+void ProcessLocalOccupancy(void)
+{
+#if ENABLE_LOCAL_OCCUPANCY
+    if (!IsEnabled)
+        return;
+
+    // Transition is started by dimming interrupt, so it is safe to call from sensor interrupt
+    IsOccupancyPending = true;
+    StartDimming();
+#endif
+}
+
 void SynchronizeLightness(void)
 {
     if (!IsEnabled)
         return;
 
-    Mesh_SendLightLightnessGet(GetLightnessServerIdx());
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        Mesh_SendLightLightnessGet(ServerIdx[channel]);
+    }
+
+#if ENABLE_DAYLIGHT_HARVESTING
+    // Setpoint follows ambient lux level of Light LC Server in run state
+    if (!CTLSupport)
+    {
+        Mesh_SendLightLCPropertyGet(ServerIdx[0], MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON);
+    }
+#endif
 }
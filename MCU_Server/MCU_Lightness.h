@@ -36,11 +36,22 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define LIGHT_CTL_TEMP_RANGE_MAX 6500 /**< Max allowed color temperature of white light in Kelvin. */
 
 /*
- *  Set Lightness Server instance index
+ *  Shape of transitions between present and target value, TRANSITION_PROFILE in Config.h
+ *  selects the one of transitions set by mesh
+ */
+#define TRANSITION_PROFILE_LINEAR 0      /**< Constant rate of lightness change */
+#define TRANSITION_PROFILE_EASE_IN_OUT 1 /**< Slow start and end, fast middle part */
+#define TRANSITION_PROFILE_PERCEPTUAL 2  /**< Constant rate of CIE 1931 L* change, applies to lightness only */
+
+typedef uint8_t TransitionProfile_T;
+
+/*
+ *  Set Lightness Server instance index of channel
  *
- *  @param idx  Lightness value
+ *  @param channel  Channel, 0 to LIGHTNESS_CHANNELS - 1
+ *  @param idx      Instance index
  */
-void SetLightnessServerIdx(uint8_t idx);
+void SetLightnessServerIdx(uint8_t channel, uint8_t idx);
 
 /*
  *  Set Lightness CTL support
@@ -50,29 +61,42 @@ void SetLightnessServerIdx(uint8_t idx);
 void SetLightCTLSupport(bool support);
 
 /*
- *  Get Lightness Server instance index
+ *  Get Lightness Server instance index of channel
  *
- *  @return     Lightness value
+ *  @param channel  Channel, 0 to LIGHTNESS_CHANNELS - 1
+ *  @return         Instance index
  */
-uint8_t GetLightnessServerIdx(void);
+uint8_t GetLightnessServerIdx(uint8_t channel);
 
 /*
  *  Process new target lightness
  *
+ *  @param instance_idx        Instance index of Lightness Server
  *  @param current             Current lightness value
  *  @param target              Target lightness value
  *  @param transition_time     Transition time
+ *  @param delay               Delay before transition starts in milliseconds
  */
-void ProcessTargetLightness(uint16_t current, uint16_t target, uint32_t transition_time);
+void ProcessTargetLightness(uint8_t  instance_idx,
+                            uint16_t current,
+                            uint16_t target,
+                            uint32_t transition_time,
+                            uint32_t delay);
 
 /*
  *  Process new target lightness temperature
  *
+ *  @param instance_idx        Instance index of Lightness Server
  *  @param current             Current lightness temperature value
  *  @param target              Target lightness temperature value
  *  @param transition_time     Transition time
+ *  @param delay               Delay before transition starts in milliseconds
  */
-void ProcessTargetLightnessTemp(uint16_t current, uint16_t target, uint32_t transition_time);
+void ProcessTargetLightnessTemp(uint8_t  instance_idx,
+                                uint16_t current,
+                                uint16_t target,
+                                uint32_t transition_time,
+                                uint32_t delay);
 
 /*
  *  Setup light lightness server hardware
@@ -94,6 +118,20 @@ void EnableStartupSequence(void);
  */
 void SynchronizeLightness(void);
 
+/*
+ *  Set ambient light level held by daylight harvesting controller (ENABLE_DAYLIGHT_HARVESTING).
+ *  Lightness set by mesh is the upper limit, controller dims output when daylight is sufficient.
+ *
+ *  @param centilux  Setpoint in centilux, 0 disables the controller
+ */
+void SetDaylightSetpoint(uint32_t centilux);
+
+/*
+ *  Indicate occupancy detected by local sensor. With ENABLE_LOCAL_OCCUPANCY, lightness is raised
+ *  immediately and returns to previous value if mesh does not confirm it. Can be called from interrupt.
+ */
+void ProcessLocalOccupancy(void);
+
 /*
  *  Indicate attention using lightness output
  *
@@ -25,8 +25,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <TimerOne.h>
 #include <TimerThree.h>
 #include <math.h>
+#include <string.h>
 
+#include "AlsAdc.h"
 #include "Config.h"
+#include "MCU_Lightness.h"
 #include "Mesh.h"
 #include "SDM.h"
 #include "UARTProtocol.h"
@@ -38,22 +41,88 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define ALS_CONVERSION_COEFFICIENT 5UL     /**< Defines light sensor coefficient [centilux / millivolt]*/
 #define PIR_DEBOUNCE_TIME_MS 20            /**< Defines PIR debounce time in milliseconds */
 #define PIR_INERTIA_MS 4000                /**< Defines PIR inertia in milliseconds */
-#define SENSOR_UPDATE_INTV_PIR 200         /**< Defines sensor update in milliseconds for PIR Sensor */
-#define SENSOR_UPDATE_INTV_ALS 200         /**< Defines sensor update in milliseconds for ALS Sensor  */
-#define SENSOR_UPDATE_INTV_VOLT_CURR 1000  /**< Defines sensor update in milliseconds for Voltage and Current Sensor  */
-#define SENSOR_UPDATE_INTV_POW_ENERGY 1000 /**< Defines sensor update in milliseconds for Power and Energy Sensor  */
+#define SENSOR_UPDATE_INTV_PIR 200         /**< Defines sampling interval in milliseconds for PIR Sensor */
+#define SENSOR_UPDATE_INTV_ALS 200         /**< Defines sampling interval in milliseconds for ALS Sensor  */
+#define SENSOR_UPDATE_INTV_VOLT_CURR 1000  /**< Defines sampling interval in milliseconds for Voltage and Current Sensor  */
+#define SENSOR_UPDATE_INTV_POW_ENERGY 1000 /**< Defines sampling interval in milliseconds for Power and Energy Sensor  */
+#define SENSOR_REPORT_MIN_INTV_ALS 1000    /**< Defines minimum time in milliseconds between ALS reports */
+#define SENSOR_REPORT_HEARTBEAT_INTV 60000 /**< Defines time in milliseconds after which unchanged value is reported */
 #define ALS_REPORT_THRESHOLD 500           /**< Defines sensor threshold in centilux */
+#define ALS_REPORT_DEADBAND 500            /**< Defines change of ambient light in centilux which triggers report */
+#define CURRENT_REPORT_DEADBAND 1          /**< Defines change of current in 0.01 A which triggers report */
+#define POWER_REPORT_DEADBAND 10           /**< Defines change of power in 0.1 W which triggers report */
+#define MESH_TOLERANCE_SCALE 4095ULL       /**< Defines tolerance value equal to 100 percent */
+#define REPORT_MAX_PROPERTIES 2            /**< Defines maximum number of properties sent in one sensor report */
 #define ANALOG_REFERENCE_VOLTAGE_MV 3300   /**< Defines ADC reference voltage in millivolts */
 #define ANALOG_MIN 0                       /**< Defines lower range of analog measurements. */
 #define ANALOG_MAX 1023                    /**< Defines uppper range of analog measurements. */
 
 
+/**
+ * Change of property value which triggers report
+ */
+typedef struct
+{
+    uint32_t absolute;  /**< Absolute change */
+    uint16_t tolerance; /**< Change relative to last reported value, encoded as sensor tolerance */
+} Deadband_T;
+
+/**
+ * Reporting policy of sensor report
+ */
+typedef struct
+{
+    uint32_t   min_interval_ms; /**< Value changes are not reported more often */
+    uint32_t   max_interval_ms; /**< Value is reported at least that often even if it did not change */
+    Deadband_T deadbands[REPORT_MAX_PROPERTIES];
+} ReportPolicy_T;
+
+/**
+ * Last sent sensor report
+ */
+typedef struct
+{
+    uint32_t values[REPORT_MAX_PROPERTIES];
+    uint32_t timestamp;
+    bool     is_reported;
+} ReportState_T;
+
+
 static bool              IsEnabled                = false;
 static volatile uint32_t PirTimestamp             = 0;
 static uint8_t           SensorServerPirIdx       = INSTANCE_INDEX_UNKNOWN;
 static uint8_t           SensorServerAlsIdx       = INSTANCE_INDEX_UNKNOWN;
 static uint8_t           SensorServerVoltCurrIdx  = INSTANCE_INDEX_UNKNOWN;
 static uint8_t           SensorServerPowEnergyIdx = INSTANCE_INDEX_UNKNOWN;
+static volatile bool     IsPirTriggered           = false;
+static ReportState_T     PirReport                = {};
+static ReportState_T     AlsReport                = {};
+static ReportState_T     VoltCurrReport           = {};
+static ReportState_T     PowEnergyReport          = {};
+
+static const ReportPolicy_T PirPolicy = {
+    0,
+    SENSOR_REPORT_HEARTBEAT_INTV,
+    {{0, PIR_POSITIVE_TOLERANCE}},
+};
+
+static const ReportPolicy_T AlsPolicy = {
+    SENSOR_REPORT_MIN_INTV_ALS,
+    SENSOR_REPORT_HEARTBEAT_INTV,
+    {{ALS_REPORT_DEADBAND, ALS_POSITIVE_TOLERANCE}},
+};
+
+static const ReportPolicy_T VoltCurrPolicy = {
+    SENSOR_UPDATE_INTV_VOLT_CURR,
+    SENSOR_REPORT_HEARTBEAT_INTV,
+    {{0, VOLTAGE_SENSOR_POSITIVE_TOLERANCE}, {CURRENT_REPORT_DEADBAND, CURRENT_SENSOR_POSITIVE_TOLERANCE}},
+};
+
+static const ReportPolicy_T PowEnergyPolicy = {
+    SENSOR_UPDATE_INTV_POW_ENERGY,
+    SENSOR_REPORT_HEARTBEAT_INTV,
+    {{POWER_REPORT_DEADBAND, POWER_SENSOR_POSITIVE_TOLERANCE}, {0, ENERGY_SENSOR_POSITIVE_TOLERANCE}},
+};
 
 
 /**
@@ -88,6 +157,17 @@ static uint32_t ConvertFloatToPower(float power);
  */
 static uint32_t ConvertFloatToEnergy(float energy);
 
+/**
+ * Check if sensor values should be reported and remember them as reported if so
+ *
+ * @param p_policy  reporting policy
+ * @param p_state   last sent report
+ * @param p_values  present values
+ * @param count     number of values
+ * @return          true if report should be sent
+ */
+static bool IsReportNeeded(const ReportPolicy_T *p_policy, ReportState_T *p_state, const uint32_t *p_values, size_t count);
+
 /**
  * Process PIR update
  */
@@ -109,6 +189,17 @@ static void ProcessVoltCurr(void);
 static void ProcessPowEnergy(void);
 
 
+uint32_t ReadAmbientLightCentilux(void)
+{
+#if ENABLE_ALS_DMA
+    uint32_t als_millivolts = (AlsAdc_Read() * ANALOG_REFERENCE_VOLTAGE_MV) / ALS_ADC_MAX;
+#else
+    uint32_t als_adc_val    = analogRead(PIN_ALS);
+    uint32_t als_millivolts = (als_adc_val * ANALOG_REFERENCE_VOLTAGE_MV) / ANALOG_MAX;
+#endif
+    return als_millivolts * ALS_CONVERSION_COEFFICIENT;
+}
+
 void SetSensorServerALSIdx(uint8_t idx)
 {
     SensorServerAlsIdx = idx;
@@ -151,7 +242,9 @@ uint8_t GetSensorServerPowEnergyIdx(void)
 
 void InterruptPIR(void)
 {
-    PirTimestamp = millis();
+    PirTimestamp   = millis();
+    IsPirTriggered = true;
+    ProcessLocalOccupancy();
 }
 
 void SetupSensorServer(void)
@@ -159,6 +252,12 @@ void SetupSensorServer(void)
     pinMode(PIN_PIR, INPUT);
 
     attachInterrupt(digitalPinToInterrupt(PIN_PIR), InterruptPIR, RISING);
+#if ENABLE_ALS_DMA
+    if (!AlsAdc_Setup(PIN_ALS))
+    {
+        INFO("ALS pin not supported by ADC sampling.\n");
+    }
+#endif
     IsEnabled = true;
 }
 
@@ -167,14 +266,20 @@ void LoopSensorServer(void)
     if (!IsEnabled)
         return;
 
+#if ENABLE_ALS_DMA
+    AlsAdc_Loop();
+#endif
+
     static unsigned long timestamp_pir        = 0;
     static unsigned long timestamp_als        = 0;
     static unsigned long timestamp_volt_curr  = 0;
     static unsigned long timestamp_pow_energy = 0;
 
-    if (timestamp_pir + SENSOR_UPDATE_INTV_PIR < millis())
+    // PIR edge is reported immediately, without waiting for sampling interval
+    if (IsPirTriggered || timestamp_pir + SENSOR_UPDATE_INTV_PIR < millis())
     {
-        timestamp_pir = millis();
+        IsPirTriggered = false;
+        timestamp_pir  = millis();
         ProcessPIR();
     }
     if (timestamp_als + SENSOR_UPDATE_INTV_ALS < millis())
@@ -201,6 +306,10 @@ static void ProcessPIR(void)
     {
         bool pir = digitalRead(PIN_PIR) || (millis() < (PirTimestamp + PIR_INERTIA_MS));
 
+        uint32_t values[] = {pir};
+        if (!IsReportNeeded(&PirPolicy, &PirReport, values, 1))
+            return;
+
         uint8_t pir_buf[] = {
             SensorServerPirIdx,
             lowByte(MESH_PROPERTY_ID_PRESENCE_DETECTED),
@@ -215,9 +324,7 @@ static void ProcessALS(void)
 {
     if (GetSensorServerALSIdx() != INSTANCE_INDEX_UNKNOWN)
     {
-        uint32_t als_adc_val    = analogRead(PIN_ALS);
-        uint32_t als_millivolts = (als_adc_val * ANALOG_REFERENCE_VOLTAGE_MV) / ANALOG_MAX;
-        uint32_t als_centilux   = als_millivolts * ALS_CONVERSION_COEFFICIENT;
+        uint32_t als_centilux = ReadAmbientLightCentilux();
 
         /*
      * Sensor server can be configured to report on change. In one mode report is triggered by
@@ -228,6 +335,10 @@ static void ProcessALS(void)
             als_centilux = 0;
         }
 
+        uint32_t values[] = {als_centilux};
+        if (!IsReportNeeded(&AlsPolicy, &AlsReport, values, 1))
+            return;
+
         uint8_t als_buf[] = {
             SensorServerAlsIdx,
             lowByte(MESH_PROPERTY_ID_PRESENT_AMBIENT_LIGHT_LEVEL),
@@ -261,6 +372,10 @@ static void ProcessVoltCurr(void)
 
     if (GetSensorServerVoltCurrIdx() != INSTANCE_INDEX_UNKNOWN)
     {
+        uint32_t values[] = {voltage, current};
+        if (!IsReportNeeded(&VoltCurrPolicy, &VoltCurrReport, values, 2))
+            return;
+
         uint8_t voltcurr_buf[] = {
             SensorServerVoltCurrIdx,
             lowByte(MESH_PROPERTY_ID_PRESENT_INPUT_VOLTAGE),
@@ -296,6 +411,10 @@ static void ProcessPowEnergy(void)
 
     if (GetSensorServerPowEnergyIdx() != INSTANCE_INDEX_UNKNOWN)
     {
+        uint32_t values[] = {power, energy};
+        if (!IsReportNeeded(&PowEnergyPolicy, &PowEnergyReport, values, 2))
+            return;
+
         uint8_t powenergy_buf[] = {
             SensorServerPowEnergyIdx,
             lowByte(MESH_PROPERTY_ID_PRESENT_DEVICE_INPUT_POWER),
@@ -313,6 +432,30 @@ static void ProcessPowEnergy(void)
     }
 }
 
+static bool IsReportNeeded(const ReportPolicy_T *p_policy, ReportState_T *p_state, const uint32_t *p_values, size_t count)
+{
+    uint32_t elapsed   = millis() - p_state->timestamp;
+    bool     is_needed = !p_state->is_reported || (elapsed >= p_policy->max_interval_ms);
+
+    for (size_t i = 0; i < count && !is_needed && elapsed >= p_policy->min_interval_ms; i++)
+    {
+        const Deadband_T *p_deadband = &p_policy->deadbands[i];
+        uint32_t          reported   = p_state->values[i];
+        uint32_t          change     = (p_values[i] > reported) ? (p_values[i] - reported) : (reported - p_values[i]);
+
+        is_needed = (change > p_deadband->absolute) &&
+                    ((uint64_t)change * MESH_TOLERANCE_SCALE > (uint64_t)reported * p_deadband->tolerance);
+    }
+
+    if (!is_needed)
+        return false;
+
+    memcpy(p_state->values, p_values, count * sizeof(p_values[0]));
+    p_state->timestamp   = millis();
+    p_state->is_reported = true;
+    return true;
+}
+
 static uint16_t ConvertFloatToVoltage(float voltage)
 {
     return (uint16_t)(voltage * 64);
@@ -323,6 +323,13 @@ void SetSensorServerPowEnergyIdx(uint8_t idx);
  */
 uint8_t GetSensorServerPowEnergyIdx(void);
 
+/*
+ *  Measure ambient light level
+ *
+ *  @return  Ambient light level in centilux
+ */
+uint32_t ReadAmbientLightCentilux(void);
+
 /*
  *  Setup sensor server hardware
  */
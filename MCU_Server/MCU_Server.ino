@@ -28,6 +28,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "MCU_DFU.h"
 #include "MCU_Health.h"
 #include "MCU_Lightness.h"
+#include "KVStore.h"
 #include "MCU_Sensor.h"
 #include "Mesh.h"
 #include "SDM.h"
@@ -156,6 +157,20 @@ static const uint8_t health_registration[] = {
     highByte(SILVAIR_ID),
 };
 
+/*
+ *  Model instance indices cached in key value store
+ */
+typedef struct
+{
+    uint8_t lightness[LIGHTNESS_CHANNELS];
+    uint8_t ctl_support;
+    uint8_t pir;
+    uint8_t als;
+    uint8_t volt_curr;
+    uint8_t pow_energy;
+    uint8_t health;
+} InstanceIndices_T;
+
 static ModemState_t ModemState = MODEM_STATE_UNKNOWN;
 
 #if ENABLE_CTL == 1 && ENABLE_LC == 1
@@ -174,6 +189,25 @@ static const bool ENERGYEnabled = (ENABLE_ENERGY != 0);
  */
 void SetupDebug(void);
 
+/*
+ *  Set model instance indices of all servers
+ *
+ *  @param * p_indices   Instance indices
+ */
+void ApplyInstanceIndices(const InstanceIndices_T *p_indices);
+
+/*
+ *  Restore model instance indices cached in last Init Node Event
+ */
+void RestoreInstanceIndices(void);
+
+/*
+ *  Cache model instance indices
+ *
+ *  @param * p_indices   Instance indices reported in Init Node Event
+ */
+void SaveInstanceIndices(const InstanceIndices_T *p_indices);
+
 /*
  *  Process Init Device Event command
  *
@@ -258,6 +292,41 @@ void SetupDebug(void)
     delay(1000);
 }
 
+void ApplyInstanceIndices(const InstanceIndices_T *p_indices)
+{
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
+    {
+        SetLightnessServerIdx(channel, p_indices->lightness[channel]);
+    }
+    SetLightCTLSupport(p_indices->ctl_support);
+    SetSensorServerPIRIdx(p_indices->pir);
+    SetSensorServerALSIdx(p_indices->als);
+    SetSensorServerVoltCurrIdx(p_indices->volt_curr);
+    SetSensorServerPowEnergyIdx(p_indices->pow_energy);
+    SetHealthServerIdx(p_indices->health);
+}
+
+void RestoreInstanceIndices(void)
+{
+    InstanceIndices_T indices;
+    if (KVStore_Read(KV_KEY_INSTANCE_INDICES, &indices, sizeof(indices)) != KV_STORE_SUCCESS)
+    {
+        return;
+    }
+
+    // Indices are valid until modem reports its own in Init Node Event.
+    ApplyInstanceIndices(&indices);
+
+    INFO("Instance indices restored.\n");
+}
+
+void SaveInstanceIndices(const InstanceIndices_T *p_indices)
+{
+    // Key value store skips writing a value equal to the stored one.
+    KVStore_Write(KV_KEY_INSTANCE_INDICES, p_indices, sizeof(*p_indices));
+    INFO("Instance indices saved.\n");
+}
+
 void ProcessEnterInitDevice(uint8_t *p_payload, uint8_t len)
 {
     INFO("Init Device State.\n");
@@ -291,9 +360,9 @@ void ProcessEnterInitDevice(uint8_t *p_payload, uint8_t len)
     size_t payload_len = 0;
 
     if (CTLEnabled)
-        payload_len += sizeof(ctl_registration);
+        payload_len += LIGHTNESS_CHANNELS * sizeof(ctl_registration);
     else if (LCEnabled)
-        payload_len += sizeof(lightness_registration);
+        payload_len += LIGHTNESS_CHANNELS * sizeof(lightness_registration);
 
     if (PIRALSEnabled)
         payload_len += sizeof(pir_registration) + sizeof(als_registration);
@@ -306,15 +375,19 @@ void ProcessEnterInitDevice(uint8_t *p_payload, uint8_t len)
     uint8_t model_ids[payload_len];
     size_t  index = 0;
 
-    if (CTLEnabled)
-    {
-        memcpy(model_ids + index, ctl_registration, sizeof(ctl_registration));
-        index += sizeof(ctl_registration);
-    }
-    else if (LCEnabled)
+    // One Light CTL/LC Server instance per channel, registered in channel order
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
     {
-        memcpy(model_ids + index, lightness_registration, sizeof(lightness_registration));
-        index += sizeof(lightness_registration);
+        if (CTLEnabled)
+        {
+            memcpy(model_ids + index, ctl_registration, sizeof(ctl_registration));
+            index += sizeof(ctl_registration);
+        }
+        else if (LCEnabled)
+        {
+            memcpy(model_ids + index, lightness_registration, sizeof(lightness_registration));
+            index += sizeof(lightness_registration);
+        }
     }
 
     if (PIRALSEnabled)
@@ -353,13 +426,13 @@ void ProcessEnterInitNode(uint8_t *p_payload, uint8_t len)
     ModemState = MODEM_STATE_INIT_NODE;
     AttentionStateSet(false);
 
-    SetLightnessServerIdx(INSTANCE_INDEX_UNKNOWN);
-    SetSensorServerPIRIdx(INSTANCE_INDEX_UNKNOWN);
-    SetSensorServerALSIdx(INSTANCE_INDEX_UNKNOWN);
-    SetSensorServerVoltCurrIdx(INSTANCE_INDEX_UNKNOWN);
-    SetSensorServerPowEnergyIdx(INSTANCE_INDEX_UNKNOWN);
+    // Cached indices stay in use until the modem reports a complete set.
+    InstanceIndices_T indices;
+    memset(&indices, INSTANCE_INDEX_UNKNOWN, sizeof(indices));
+    indices.ctl_support = false;
 
-    uint8_t sensor_server_model_id_occurency = 0;
+    uint8_t sensor_server_model_id_occurency    = 0;
+    uint8_t lightness_server_model_id_occurency = 0;
 
     for (size_t index = 0; index < len;)
     {
@@ -369,8 +442,12 @@ void ProcessEnterInitNode(uint8_t *p_payload, uint8_t len)
         if (MESH_MODEL_ID_LIGHT_CTL_SERVER == model_id || MESH_MODEL_ID_LIGHT_LC_SERVER == model_id)
         {
             uint16_t current_model_id_instance_index = index / 2;
-            SetLightnessServerIdx(current_model_id_instance_index);
-            SetLightCTLSupport(model_id == MESH_MODEL_ID_LIGHT_CTL_SERVER);
+            if (lightness_server_model_id_occurency < LIGHTNESS_CHANNELS)
+            {
+                indices.lightness[lightness_server_model_id_occurency] = current_model_id_instance_index;
+            }
+            lightness_server_model_id_occurency++;
+            indices.ctl_support = (model_id == MESH_MODEL_ID_LIGHT_CTL_SERVER);
         }
 
         if (model_id == MESH_MODEL_ID_SENSOR_SERVER)
@@ -380,71 +457,77 @@ void ProcessEnterInitNode(uint8_t *p_payload, uint8_t len)
 
             if (sensor_server_model_id_occurency == PIR_REGISTRATION_ORDER && PIRALSEnabled)
             {
-                SetSensorServerPIRIdx(current_model_id_instance_index);
+                indices.pir = current_model_id_instance_index;
             }
             else if (sensor_server_model_id_occurency == ALS_REGISTRATION_ORDER && PIRALSEnabled)
             {
-                SetSensorServerALSIdx(current_model_id_instance_index);
+                indices.als = current_model_id_instance_index;
             }
             else if (sensor_server_model_id_occurency == VOLT_CURR_REGISTRATION_ORDER && ENERGYEnabled)
             {
-                SetSensorServerVoltCurrIdx(current_model_id_instance_index);
+                indices.volt_curr = current_model_id_instance_index;
             }
             else if (sensor_server_model_id_occurency == POW_ENERGY_REGISTRATION_ORDER && ENERGYEnabled)
             {
-                SetSensorServerPowEnergyIdx(current_model_id_instance_index);
+                indices.pow_energy = current_model_id_instance_index;
             }
         }
 
         if (model_id == MESH_MODEL_ID_HEALTH_SERVER)
         {
             uint16_t current_model_id_instance_index = index / 2;
-            SetHealthServerIdx(current_model_id_instance_index);
+            indices.health = current_model_id_instance_index;
         }
     }
 
-    if (GetLightnessServerIdx() == INSTANCE_INDEX_UNKNOWN && (LCEnabled || CTLEnabled))
+    for (size_t channel = 0; channel < LIGHTNESS_CHANNELS; channel++)
     {
-        ModemState = MODEM_STATE_UNKNOWN;
-        INFO("Light CTL/LC Server model id not found in init node message\n");
-        return;
+        if (indices.lightness[channel] == INSTANCE_INDEX_UNKNOWN && (LCEnabled || CTLEnabled))
+        {
+            ModemState = MODEM_STATE_UNKNOWN;
+            INFO("Light CTL/LC Server model id of channel %d not found in init node message\n", channel);
+            return;
+        }
     }
 
-    if (GetSensorServerPIRIdx() == INSTANCE_INDEX_UNKNOWN && PIRALSEnabled)
+    if (indices.pir == INSTANCE_INDEX_UNKNOWN && PIRALSEnabled)
     {
         ModemState = MODEM_STATE_UNKNOWN;
         INFO("Sensor server (PIR) model id not found in init node message\n");
         return;
     }
 
-    if (GetSensorServerALSIdx() == INSTANCE_INDEX_UNKNOWN && PIRALSEnabled)
+    if (indices.als == INSTANCE_INDEX_UNKNOWN && PIRALSEnabled)
     {
         ModemState = MODEM_STATE_UNKNOWN;
         INFO("Sensor server (ALS) model id not found in init node message\n");
         return;
     }
 
-    if (GetSensorServerVoltCurrIdx() == INSTANCE_INDEX_UNKNOWN && ENERGYEnabled)
+    if (indices.volt_curr == INSTANCE_INDEX_UNKNOWN && ENERGYEnabled)
     {
         ModemState = MODEM_STATE_UNKNOWN;
         INFO("Sensor server (Voltage Current) model id not found in init node message\n");
         return;
     }
 
-    if (GetSensorServerPowEnergyIdx() == INSTANCE_INDEX_UNKNOWN && ENERGYEnabled)
+    if (indices.pow_energy == INSTANCE_INDEX_UNKNOWN && ENERGYEnabled)
     {
         ModemState = MODEM_STATE_UNKNOWN;
         INFO("Sensor server (Power Energy) model id not found in init node message\n");
         return;
     }
 
-    if (GetHealthServerIdx() == INSTANCE_INDEX_UNKNOWN)
+    if (indices.health == INSTANCE_INDEX_UNKNOWN)
     {
         ModemState = MODEM_STATE_UNKNOWN;
         INFO("Health Server model id not found in init node message\n");
         return;
     }
 
+    ApplyInstanceIndices(&indices);
+    SaveInstanceIndices(&indices);
+
     SendFirmwareVersionSetRequest();
     UART_StartNodeRequest();
 }
@@ -482,6 +565,7 @@ void setup(void)
 {
     SetupDebug();
     INFO("Server Sample.\n");
+    KVStore_Init();
     SetupAttention();
     SetupHealth();
 
@@ -492,6 +576,8 @@ void setup(void)
     if (ENERGYEnabled)
         SetupSDM();
 
+    RestoreInstanceIndices();
+
     UART_Init();
     UART_SendSoftwareResetRequest();
 
@@ -511,6 +597,7 @@ void loop(void)
 
     LoopLightnessServer();
     LoopSDM();
+    LoopDFU();
 
     if (MODEM_STATE_NODE == ModemState)
     {
@@ -38,11 +38,14 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define MESH_MESSAGE_LEVEL_STATUS 0x8208
 #define MESH_MESSAGE_LIGHT_CTL_TEMPERATURE_STATUS 0x8266
 #define MESH_MESSAGE_LEVEL_GET 0x8205
+#define MESH_MESSAGE_LIGHT_LC_PROPERTY_GET 0x829D
+#define MESH_MESSAGE_LIGHT_LC_PROPERTY_STATUS 0x0064
 
 /**
  * Used Mesh Messages len
  */
 #define MESH_MESSAGE_LIGHT_LIGHTNESS_GET_LEN 4
+#define MESH_MESSAGE_LIGHT_LC_PROPERTY_GET_LEN 6
 
 /*
  * Mesh time conversion definitions
@@ -58,6 +61,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define MESH_TRANSITION_TIME_STEP_RESOLUTION_10_MIN 0xC0
 #define MESH_TRANSITION_TIME_NUMBER_OF_STEPS_MASK 0x3F
 #define MESH_TRANSITION_TIME_NUMBER_OF_STEPS_UNKNOWN_VALUE 0x3F
+#define MESH_DELAY_STEP_MS 5UL /**< Delay field of Set messages is expressed in 5 millisecond steps */
 
 /**
  * Property IDs description
@@ -78,26 +82,40 @@ static bool MeshInternal_ConvertFromMeshFormatToMsTransitionTime(uint8_t time_me
 /*
  *  Process Light Lightness Status mesh message
  *
+ *  @param instance_idx  Instance index of message source
  *  @param * p_payload   Pointer mesh message payload
  *  @param len           Payload length
  */
-static void MeshInternal_ProcessLightLightnessStatus(uint8_t *p_payload, size_t len);
+static void MeshInternal_ProcessLightLightnessStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len);
 
 /*
  *  Process Generic Level Status mesh message
  *
+ *  @param instance_idx  Instance index of message source
  *  @param * p_payload   Pointer mesh message payload
  *  @param len           Payload length
  */
-static void MeshInternal_ProcessLevelStatus(uint8_t *p_payload, size_t len);
+static void MeshInternal_ProcessLevelStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len);
 
 /*
  *  Process Light CTL Status mesh message
  *
+ *  @param instance_idx  Instance index of message source
  *  @param * p_payload   Pointer mesh message payload
  *  @param len           Payload length
  */
-static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t *p_payload, size_t len);
+static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len);
+
+#if ENABLE_DAYLIGHT_HARVESTING
+/*
+ *  Process Light LC Property Status mesh message
+ *
+ *  @param instance_idx  Instance index of message source
+ *  @param * p_payload   Pointer mesh message payload
+ *  @param len           Payload length
+ */
+static void MeshInternal_ProcessLightLCPropertyStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len);
+#endif
 
 
 bool Mesh_IsModelAvailable(uint8_t *p_payload, uint8_t len, uint16_t expected_model_id)
@@ -128,19 +146,26 @@ void Mesh_ProcessMeshCommand(uint8_t *p_payload, size_t len)
     {
         case MESH_MESSAGE_LIGHT_LIGHTNESS_STATUS:
         {
-            MeshInternal_ProcessLightLightnessStatus(p_payload + index, len - index);
+            MeshInternal_ProcessLightLightnessStatus(instance_index, p_payload + index, len - index);
             break;
         }
         case MESH_MESSAGE_LEVEL_STATUS:
         {
-            MeshInternal_ProcessLevelStatus(p_payload + index, len - index);
+            MeshInternal_ProcessLevelStatus(instance_index, p_payload + index, len - index);
             break;
         }
         case MESH_MESSAGE_LIGHT_CTL_TEMPERATURE_STATUS:
         {
-            MeshInternal_ProcessLightCTLTemperatureStatus(p_payload + index, len - index);
+            MeshInternal_ProcessLightCTLTemperatureStatus(instance_index, p_payload + index, len - index);
+            break;
+        }
+#if ENABLE_DAYLIGHT_HARVESTING
+        case MESH_MESSAGE_LIGHT_LC_PROPERTY_STATUS:
+        {
+            MeshInternal_ProcessLightLCPropertyStatus(instance_index, p_payload + index, len - index);
             break;
         }
+#endif
     }
 }
 
@@ -157,13 +182,29 @@ void Mesh_SendLightLightnessGet(uint8_t instance_idx)
     UART_SendMeshMessageRequest(buf, sizeof(buf));
 }
 
+void Mesh_SendLightLCPropertyGet(uint8_t instance_idx, uint16_t property_id)
+{
+    uint8_t buf[MESH_MESSAGE_LIGHT_LC_PROPERTY_GET_LEN];
+    size_t  index = 0;
+
+    buf[index++] = instance_idx;
+    buf[index++] = 0x00;
+    buf[index++] = lowByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_GET);
+    buf[index++] = highByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_GET);
+    buf[index++] = lowByte(property_id);
+    buf[index++] = highByte(property_id);
+
+    UART_SendMeshMessageRequest(buf, sizeof(buf));
+}
+
 
-static void MeshInternal_ProcessLightLightnessStatus(uint8_t *p_payload, size_t len)
+static void MeshInternal_ProcessLightLightnessStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len)
 {
     size_t   index = 0;
     uint16_t present_value;
     uint16_t target_value;
     uint32_t transition_time_ms;
+    uint32_t delay_ms = 0;
 
     present_value = ((uint16_t)p_payload[index++]);
     present_value |= ((uint16_t)p_payload[index++] << 8);
@@ -179,6 +220,14 @@ static void MeshInternal_ProcessLightLightnessStatus(uint8_t *p_payload, size_t
             INFO("Rejected Transition Time\n");
             return;
         }
+
+#if ENABLE_MESH_DELAY
+        // Delay follows Transition Time only when forwarded by modem
+        if (index < len)
+        {
+            delay_ms = p_payload[index++] * MESH_DELAY_STEP_MS;
+        }
+#endif
     }
     else
     {
@@ -186,15 +235,16 @@ static void MeshInternal_ProcessLightLightnessStatus(uint8_t *p_payload, size_t
         transition_time_ms = 0;
     }
 
-    ProcessTargetLightness(present_value, target_value, transition_time_ms);
+    ProcessTargetLightness(instance_idx, present_value, target_value, transition_time_ms, delay_ms);
 }
 
-static void MeshInternal_ProcessLevelStatus(uint8_t *p_payload, size_t len)
+static void MeshInternal_ProcessLevelStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len)
 {
     size_t   index = 0;
     int16_t  target_value;
     int16_t  present_value;
     uint32_t transition_time_ms;
+    uint32_t delay_ms = 0;
 
     present_value = ((uint16_t)p_payload[index++]);
     present_value |= ((uint16_t)p_payload[index++] << 8);
@@ -210,6 +260,14 @@ static void MeshInternal_ProcessLevelStatus(uint8_t *p_payload, size_t len)
             INFO("Rejected Transition Time\n");
             return;
         }
+
+#if ENABLE_MESH_DELAY
+        // Delay follows Transition Time only when forwarded by modem
+        if (index < len)
+        {
+            delay_ms = p_payload[index++] * MESH_DELAY_STEP_MS;
+        }
+#endif
     }
     else
     {
@@ -220,10 +278,10 @@ static void MeshInternal_ProcessLevelStatus(uint8_t *p_payload, size_t len)
     uint16_t present_lightness = present_value - INT16_MIN;
     uint16_t target_lightness  = target_value - INT16_MIN;
 
-    ProcessTargetLightness(present_lightness, target_lightness, transition_time_ms);
+    ProcessTargetLightness(instance_idx, present_lightness, target_lightness, transition_time_ms, delay_ms);
 }
 
-static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t *p_payload, size_t len)
+static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len)
 {
     size_t   index = 0;
     uint16_t present_temperature;
@@ -231,6 +289,7 @@ static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t *p_payload, si
     uint16_t target_temperature;
     uint16_t target_delta_uv;
     uint32_t transition_time_ms;
+    uint32_t delay_ms = 0;
 
     present_temperature = ((uint16_t)p_payload[index++]);
     present_temperature |= ((uint16_t)p_payload[index++] << 8);
@@ -252,6 +311,14 @@ static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t *p_payload, si
             INFO("Rejected Transition Time\n");
             return;
         }
+
+#if ENABLE_MESH_DELAY
+        // Delay follows Transition Time only when forwarded by modem
+        if (index < len)
+        {
+            delay_ms = p_payload[index++] * MESH_DELAY_STEP_MS;
+        }
+#endif
     }
     else
     {
@@ -260,8 +327,33 @@ static void MeshInternal_ProcessLightCTLTemperatureStatus(uint8_t *p_payload, si
         transition_time_ms = 0;
     }
 
-    ProcessTargetLightnessTemp(present_temperature, target_temperature, transition_time_ms);
+    ProcessTargetLightnessTemp(instance_idx, present_temperature, target_temperature, transition_time_ms, delay_ms);
+}
+
+#if ENABLE_DAYLIGHT_HARVESTING
+static void MeshInternal_ProcessLightLCPropertyStatus(uint8_t instance_idx, uint8_t *p_payload, size_t len)
+{
+    size_t   index = 0;
+    uint16_t property_id;
+    uint32_t centilux;
+
+    // Property ID and 24 bit Illuminance value
+    if (len < 5)
+        return;
+
+    property_id = ((uint16_t)p_payload[index++]);
+    property_id |= ((uint16_t)p_payload[index++] << 8);
+
+    if (property_id != MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON)
+        return;
+
+    centilux = ((uint32_t)p_payload[index++]);
+    centilux |= ((uint32_t)p_payload[index++] << 8);
+    centilux |= ((uint32_t)p_payload[index++] << 16);
+
+    SetDaylightSetpoint(centilux);
 }
+#endif
 
 static bool MeshInternal_ConvertFromMeshFormatToMsTransitionTime(uint8_t time_mesh_format, uint32_t *p_time_ms)
 {
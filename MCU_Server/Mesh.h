@@ -44,6 +44,7 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define MESH_PROPERTY_ID_PRESENT_INPUT_VOLTAGE 0x0059
 #define MESH_PROPERTY_ID_PRESENT_DEVICE_INPUT_POWER 0x0052
 #define MESH_PROPERTY_ID_TOTAL_DEVICE_ENERGY_USE 0x006A
+#define MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON 0x002B
 
 
 /*
@@ -71,22 +72,49 @@ void Mesh_ProcessMeshCommand(uint8_t *p_payload, size_t len);
  */
 void Mesh_SendLightLightnessGet(uint8_t instance_idx);
 
+/*
+ *  Send Light LC Property Get message
+ *
+ *  @param instance_idx    Instance index of Light LC Server
+ *  @param property_id     Property ID
+ */
+void Mesh_SendLightLCPropertyGet(uint8_t instance_idx, uint16_t property_id);
+
 /*
  *  Process new target lightness
  *
+ *  @param instance_idx        Instance index of Lightness Server
  *  @param current             Current lightness value
  *  @param target              Target lightness value
  *  @param transition_time     Transition time
+ *  @param delay               Delay before transition starts in milliseconds
  */
-extern void ProcessTargetLightness(uint16_t current, uint16_t target, uint32_t transition_time);
+extern void ProcessTargetLightness(uint8_t  instance_idx,
+                                   uint16_t current,
+                                   uint16_t target,
+                                   uint32_t transition_time,
+                                   uint32_t delay);
 
 /*
  *  Process new target lightness temperature
  *
+ *  @param instance_idx        Instance index of Lightness Server
  *  @param current             Current lightness temperature value
  *  @param target              Target lightness temperature value
  *  @param transition_time     Transition time
+ *  @param delay               Delay before transition starts in milliseconds
+ */
+extern void ProcessTargetLightnessTemp(uint8_t  instance_idx,
+                                       uint16_t current,
+                                       uint16_t target,
+                                       uint32_t transition_time,
+                                       uint32_t delay);
+
+/*
+ *  Process new ambient light level held by daylight harvesting controller
+ *
+ *  @param centilux            Setpoint in centilux, 0 disables the controller
  */
-extern void ProcessTargetLightnessTemp(uint16_t current, uint16_t target, uint32_t transition_time);
+extern void SetDaylightSetpoint(uint32_t centilux);
 
 #endif    // MESH_H_
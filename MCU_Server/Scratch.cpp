@@ -0,0 +1,121 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Scratch.h"
+
+
+#define SCRATCH_STACK_RESERVE 1536u /**< RAM left for stack growth below current stack pointer */
+#define SCRATCH_ALIGN 4u            /**< Arena alignment */
+
+
+extern "C" char *sbrk(int incr);
+
+
+static uint8_t *Arena     = NULL;
+static bool     IsInUse   = false;
+static size_t   ArenaSize = 0; /**< Size of arena kept between heap and stack, 0 if it was returned */
+
+
+/*
+ *  Get number of bytes between heap end and stack reserve
+ *
+ *  @return          Number of bytes
+ */
+static size_t Scratch_GetGap(void);
+
+
+size_t Scratch_GetAvailable(void)
+{
+    if (IsInUse)
+    {
+        return 0;
+    }
+
+    // Free heap chunks are not counted, as they may be scattered. Arena which couldn't be returned,
+    // because heap grew after it, can be reused up to its size.
+    size_t available = Scratch_GetGap();
+    return (ArenaSize > available) ? ArenaSize : available;
+}
+
+uint8_t *Scratch_Acquire(size_t size)
+{
+    if (IsInUse)
+    {
+        return NULL;
+    }
+
+    if (ArenaSize >= size)
+    {
+        IsInUse = true;
+        return Arena;
+    }
+
+    if (size > Scratch_GetGap())
+    {
+        return NULL;
+    }
+
+    // Arena is taken from the gap, so it doesn't fragment heap. Smaller arena kept before stays unused.
+    uint8_t *p_heap_end = (uint8_t *)sbrk(0);
+    size_t   padding    = (SCRATCH_ALIGN - ((uintptr_t)p_heap_end % SCRATCH_ALIGN)) % SCRATCH_ALIGN;
+    uint8_t *p_arena    = (uint8_t *)sbrk(padding + size);
+    if (p_arena == (uint8_t *)-1)
+    {
+        return NULL;
+    }
+
+    Arena     = p_arena + padding;
+    ArenaSize = size;
+    IsInUse   = true;
+    return Arena;
+}
+
+void Scratch_Release(void)
+{
+    if (!IsInUse)
+    {
+        return;
+    }
+
+    IsInUse = false;
+
+    // Arena is kept for the next owner if heap grew after it.
+    if ((uint8_t *)sbrk(0) == Arena + ArenaSize)
+    {
+        sbrk(-(int)ArenaSize);
+        Arena     = NULL;
+        ArenaSize = 0;
+    }
+}
+
+static size_t Scratch_GetGap(void)
+{
+    uint8_t  stack_top;
+    uint8_t *p_heap_end = (uint8_t *)sbrk(0);
+
+    if (&stack_top <= p_heap_end + SCRATCH_STACK_RESERVE + SCRATCH_ALIGN)
+    {
+        return 0;
+    }
+
+    return (&stack_top - p_heap_end) - SCRATCH_STACK_RESERVE - SCRATCH_ALIGN;
+}
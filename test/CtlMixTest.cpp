@@ -0,0 +1,234 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host test of CTL warm and cold mixing against the previous 64 bit split, with a benchmark of output
+ *  calculation. Build and run with 'make test', with and without TEST_OUTPUT_CALIBRATION.
+ */
+
+#include "Config.h"
+
+#undef ENABLE_OUTPUT_CALIBRATION
+#define ENABLE_OUTPUT_CALIBRATION TEST_OUTPUT_CALIBRATION
+
+#include "MCU_Lightness.cpp"
+
+#include <time.h>
+
+#include "Test.h"
+
+
+#define GOLDEN_LIGHTNESS_STRIDE 13u   /**< Lightness step of golden tests, all temperatures in range are tested */
+#define GOLDEN_ERROR_MAX 1            /**< Allowed difference from previous split in PWM counts */
+#define GOLDEN_ERROR_MAX_CALIBRATED 2 /**< Allowed difference from calibration curve in PWM counts */
+#define BENCHMARK_STEPS 1000000u      /**< Number of measured output calculations */
+
+
+int KVStore_Read(uint8_t key, void *p_value, size_t len)
+{
+    return KV_STORE_ERROR_NOT_FOUND;
+}
+
+int KVStore_Write(uint8_t key, const void *p_value, size_t len)
+{
+    return KV_STORE_SUCCESS;
+}
+
+void Mesh_SendLightLightnessGet(uint8_t instance_idx)
+{
+}
+
+
+/*
+ *  Split PWM duty between warm and cold outputs as before Q15 mix ratio, with two 64 bit divisions
+ *
+ *  @param pwm_out       PWM duty
+ *  @param temperature   Temperature, within CTL range
+ *  @param is_soft       Divide bit by bit, as on Cortex-M0+
+ *  @param p_warm        [out] Warm duty
+ *  @param p_cold        [out] Cold duty
+ */
+static void PreviousSplit(uint32_t pwm_out, uint16_t temperature, bool is_soft, uint32_t *p_warm, uint32_t *p_cold)
+{
+    const uint64_t range = LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN;
+
+    uint64_t cold = (uint64_t)(LIGHT_CTL_TEMP_RANGE_MAX - temperature) * pwm_out;
+    uint64_t warm = (uint64_t)(temperature - LIGHT_CTL_TEMP_RANGE_MIN) * pwm_out;
+
+    *p_cold = is_soft ? Test_SoftDivide(cold, range, 64) : cold / range;
+    *p_warm = is_soft ? Test_SoftDivide(warm, range, 64) : warm / range;
+}
+
+/*
+ *  Expected PWM output of LED string for light output of the string
+ *
+ *  @param light     Light output with LIGHTNESS_TABLE_FRACTION_BITS fractional bits
+ *  @param is_warm   Warm string
+ *  @return          PWM output in counts
+ */
+static double ExpectedOutput(uint32_t light, bool is_warm)
+{
+#if ENABLE_OUTPUT_CALIBRATION
+    if ((light >> LIGHTNESS_TABLE_FRACTION_BITS) == 0)
+    {
+        return 0.0;
+    }
+
+    double linear = (light >> LIGHTNESS_TABLE_FRACTION_BITS) / (double)UINT16_MAX;
+    double output = is_warm ? OutputCurveWarm::Linear(linear) : OutputCurveCold::Linear(linear);
+    return PWM_OUTPUT_MIN + output * (PWM_OUTPUT_MAX - PWM_OUTPUT_MIN);
+#else
+    return light >> LIGHTNESS_TABLE_FRACTION_BITS;
+#endif
+}
+
+/*
+ *  Set present temperature of first channel
+ *
+ *  @param temperature   Temperature
+ */
+static void SetTemperature(uint16_t temperature)
+{
+    TransitionTiming_T timing = CalculateTransitionTiming(0);
+    Temperature[0]            = CalculateTransition(temperature, temperature, &timing, TRANSITION_PROFILE_LINEAR);
+}
+
+/*
+ *  Compare warm and cold output with previous split over all temperatures in CTL range
+ */
+static void TestMixGolden(void)
+{
+    double max_error = 0.0;
+
+    CTLSupport = true;
+    for (uint32_t temperature = LIGHT_CTL_TEMP_RANGE_MIN; temperature <= LIGHT_CTL_TEMP_RANGE_MAX; temperature++)
+    {
+        SetTemperature(temperature);
+
+        for (uint32_t val = 0; val <= UINT16_MAX; val += GOLDEN_LIGHTNESS_STRIDE)
+        {
+            uint32_t warm, cold, previous_warm, previous_cold;
+            CalculateOutput(0, val, &warm, &cold);
+            PreviousSplit(PwmTable.Lookup(val), temperature, false, &previous_warm, &previous_cold);
+
+            max_error = max(max_error, fabs((warm >> LIGHTNESS_TABLE_FRACTION_BITS) - ExpectedOutput(previous_warm, true)));
+            max_error = max(max_error, fabs((cold >> LIGHTNESS_TABLE_FRACTION_BITS) - ExpectedOutput(previous_cold, false)));
+        }
+    }
+
+    printf("Mix: max difference from previous split %.1f\n", max_error);
+#if ENABLE_OUTPUT_CALIBRATION
+    CHECK(max_error <= GOLDEN_ERROR_MAX_CALIBRATED);
+#else
+    CHECK(max_error <= GOLDEN_ERROR_MAX);
+#endif
+}
+
+/*
+ *  Temperature outside CTL range is clamped, output is warm or cold only
+ */
+static void TestMixClamp(void)
+{
+    uint32_t warm, cold, full_warm, full_cold;
+
+    CTLSupport = true;
+    SetTemperature(LIGHT_CTL_TEMP_RANGE_MAX);
+    CalculateOutput(0, UINT16_MAX / 2, &full_warm, &full_cold);
+    SetTemperature(UINT16_MAX);
+    CalculateOutput(0, UINT16_MAX / 2, &warm, &cold);
+    CHECK(cold == full_cold);
+    CHECK(warm == full_warm);
+    CHECK((cold >> LIGHTNESS_TABLE_FRACTION_BITS) == 0);
+
+    SetTemperature(LIGHT_CTL_TEMP_RANGE_MIN);
+    CalculateOutput(0, UINT16_MAX / 2, &full_warm, &full_cold);
+    SetTemperature(800);
+    CalculateOutput(0, UINT16_MAX / 2, &warm, &cold);
+    CHECK(cold == full_cold);
+    CHECK(warm == full_warm);
+    CHECK((warm >> LIGHTNESS_TABLE_FRACTION_BITS) == 0);
+}
+
+/*
+ *  Measure host time of output calculation during lightness transition
+ *
+ *  @param is_previous       Calculate previous split instead of CalculateOutput
+ *  @param is_soft           Previous split divides bit by bit
+ *  @param is_temperature    Temperature changes on each calculation, so mix ratio is recalculated
+ *  @return                  Nanoseconds per calculation
+ */
+static double BenchmarkMix(bool is_previous, bool is_soft, bool is_temperature)
+{
+    const uint32_t    range = LIGHT_CTL_TEMP_RANGE_MAX - LIGHT_CTL_TEMP_RANGE_MIN + 1;
+    volatile uint32_t sink  = 0;
+    struct timespec   begin;
+    struct timespec   end;
+
+    CTLSupport = true;
+    SetTemperature(LIGHT_CTL_TEMP_DEFAULT);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (uint32_t step = 0; step < BENCHMARK_STEPS; step++)
+    {
+        uint16_t val         = step;
+        uint16_t temperature = LIGHT_CTL_TEMP_DEFAULT;
+        uint32_t warm, cold;
+
+        if (is_temperature)
+        {
+            temperature                  = LIGHT_CTL_TEMP_RANGE_MIN + step % range;
+            Temperature[0].present_value = (uint32_t)temperature << TRANSITION_FRACTION_BITS;
+        }
+
+        if (is_previous)
+        {
+            PreviousSplit(PwmTable.Lookup(val), temperature, is_soft, &warm, &cold);
+        }
+        else
+        {
+            CalculateOutput(0, val, &warm, &cold);
+        }
+        sink = sink + warm + cold;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ns = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+    return elapsed_ns / BENCHMARK_STEPS;
+}
+
+int main(void)
+{
+    TestMixGolden();
+    TestMixClamp();
+
+    double previous_ns      = BenchmarkMix(true, false, false);
+    double previous_soft_ns = BenchmarkMix(true, true, false);
+    double steady_ns        = BenchmarkMix(false, false, false);
+    double changing_ns      = BenchmarkMix(false, false, true);
+    printf("Output: previous %.1f ns, with bitwise division %.1f ns, now %.1f ns, %.1f ns with changing temperature (host)\n",
+           previous_ns,
+           previous_soft_ns,
+           steady_ns,
+           changing_ns);
+
+    return Test_Result();
+}
@@ -0,0 +1,212 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host simulation of daylight harvesting PI controller. Ambient light sensor sees daylight and light of
+ *  the luminaire, setpoint is received in Light LC Property Status. Build and run with 'make test'.
+ */
+
+#include "Config.h"
+
+#undef ENABLE_DAYLIGHT_HARVESTING
+#define ENABLE_DAYLIGHT_HARVESTING 1
+
+// Logs are compiled in and dropped by host Serial
+#undef LOG_INFO_ENABLE
+#define LOG_INFO_ENABLE 1
+#undef LOG_DEBUG_ENABLE
+#define LOG_DEBUG_ENABLE 1
+
+#include "MCU_Lightness.cpp"
+#include "Mesh.cpp"
+
+#include "Test.h"
+
+
+#define LC_SERVER_IDX 3u                    /**< Instance index of simulated Light LC Server */
+#define LUMINAIRE_CENTILUX 20000u           /**< Light of luminaire at full output seen by sensor */
+#define SETPOINT_CENTILUX 10000u            /**< Setpoint sent by mesh */
+#define SETTLE_TIME_MS 10000u               /**< Time allowed to reach setpoint */
+#define SETTLE_ERROR_MAX_CENTILUX 300       /**< Allowed error after settling */
+#define OVERSHOOT_MAX_CENTILUX 1500         /**< Allowed overshoot after setpoint step */
+#define RAMP_TIME_MS (20u * 60u * 1000u)    /**< Daylight rises from 0 to RAMP_PEAK_CENTILUX and back in this time */
+#define RAMP_PEAK_CENTILUX 16000u           /**< Daylight at the middle of the ramp */
+#define TRACKING_ERROR_MAX_CENTILUX 300     /**< Allowed error while setpoint can be held */
+#define MESSAGE_MAX_LEN 16u                 /**< Longest recorded mesh message */
+
+
+static uint32_t Daylight      = 0; /**< Simulated daylight in centilux */
+static uint8_t  LastMessage[MESSAGE_MAX_LEN];
+static size_t   LastMessageLen = 0;
+
+
+int KVStore_Read(uint8_t key, void *p_value, size_t len)
+{
+    return KV_STORE_ERROR_NOT_FOUND;
+}
+
+int KVStore_Write(uint8_t key, const void *p_value, size_t len)
+{
+    return KV_STORE_SUCCESS;
+}
+
+void UART_SendMeshMessageRequest(uint8_t *p_payload, uint8_t len)
+{
+    LastMessageLen = min(len, MESSAGE_MAX_LEN);
+    memcpy(LastMessage, p_payload, LastMessageLen);
+}
+
+uint32_t ReadAmbientLightCentilux(void)
+{
+    uint32_t duty = Host_AnalogOutput[PIN_PWM_COLD];
+    return Daylight + (uint64_t)LUMINAIRE_CENTILUX * duty / PWM_OUTPUT_MAX;
+}
+
+
+/*
+ *  Run dimming interrupt, when it is running, and main loop for given time
+ *
+ *  @param time_ms   Simulated time
+ */
+static void Run(uint32_t time_ms)
+{
+    for (uint32_t elapsed = 0; elapsed < time_ms; elapsed += DIMM_INTERRUPT_TIME_MS)
+    {
+        Host_Millis += DIMM_INTERRUPT_TIME_MS;
+        if (Timer1.IsRunning)
+        {
+            Timer1.Isr();
+        }
+        LoopLightnessServer();
+    }
+}
+
+/*
+ *  Send Light LC Property Status with ambient lux level in run state
+ *
+ *  @param centilux  Lux level in centilux
+ */
+static void ReceiveLuxLevelOn(uint32_t centilux)
+{
+    uint8_t message[] = {
+        LC_SERVER_IDX,
+        0x00,
+        lowByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_STATUS),
+        highByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_STATUS),
+        lowByte(MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON),
+        highByte(MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON),
+        (uint8_t)centilux,
+        (uint8_t)(centilux >> 8),
+        (uint8_t)(centilux >> 16),
+    };
+
+    Mesh_ProcessMeshCommand(message, sizeof(message));
+}
+
+/*
+ *  Check that synchronization requests the setpoint and that property status sets it
+ */
+static void TestSetpointFromMesh(void)
+{
+    SynchronizeLightness();
+
+    CHECK(LastMessageLen == MESH_MESSAGE_LIGHT_LC_PROPERTY_GET_LEN);
+    CHECK(LastMessage[0] == LC_SERVER_IDX);
+    CHECK(LastMessage[2] == lowByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_GET));
+    CHECK(LastMessage[3] == highByte(MESH_MESSAGE_LIGHT_LC_PROPERTY_GET));
+    CHECK(LastMessage[4] == lowByte(MESH_PROPERTY_ID_LIGHT_CONTROL_AMBIENT_LUXLEVEL_ON));
+
+    ReceiveLuxLevelOn(SETPOINT_CENTILUX);
+    CHECK(DaylightSetpoint == SETPOINT_CENTILUX);
+}
+
+/*
+ *  Step of setpoint without daylight, luminaire has to settle at setpoint without large overshoot
+ */
+static void TestSetpointStep(void)
+{
+    uint32_t settle_ms = 0;
+    uint32_t lowest    = UINT32_MAX;
+
+    Daylight = 0;
+    ReceiveLuxLevelOn(0);
+    ProcessTargetLightness(LC_SERVER_IDX, 0, UINT16_MAX, 0, 0);
+    Run(1000);
+    CHECK(ReadAmbientLightCentilux() == LUMINAIRE_CENTILUX);
+
+    ReceiveLuxLevelOn(SETPOINT_CENTILUX);
+    for (uint32_t time_ms = 0; time_ms < SETTLE_TIME_MS; time_ms += DAYLIGHT_CONTROL_INTERVAL_MS)
+    {
+        Run(DAYLIGHT_CONTROL_INTERVAL_MS);
+
+        int32_t error = (int32_t)ReadAmbientLightCentilux() - SETPOINT_CENTILUX;
+        lowest        = min(lowest, ReadAmbientLightCentilux());
+        if (abs(error) > SETTLE_ERROR_MAX_CENTILUX)
+            settle_ms = time_ms + DAYLIGHT_CONTROL_INTERVAL_MS;
+    }
+
+    printf("Setpoint step: settled in %u ms, lowest %u centilux\n", settle_ms, lowest);
+    CHECK(settle_ms < SETTLE_TIME_MS);
+    CHECK(lowest + OVERSHOOT_MAX_CENTILUX >= SETPOINT_CENTILUX);
+}
+
+/*
+ *  Daylight rises and falls, setpoint is held while daylight leaves room for the luminaire
+ */
+static void TestDaylightRamp(void)
+{
+    int32_t  max_error    = 0;
+    uint32_t lowest_trim  = DAYLIGHT_TRIM_ONE;
+    uint32_t half_time_ms = RAMP_TIME_MS / 2;
+
+    for (uint32_t time_ms = 0; time_ms < RAMP_TIME_MS; time_ms += DAYLIGHT_CONTROL_INTERVAL_MS)
+    {
+        uint32_t distance = (time_ms < half_time_ms) ? time_ms : RAMP_TIME_MS - time_ms;
+        Daylight          = (uint64_t)RAMP_PEAK_CENTILUX * distance / half_time_ms;
+        Run(DAYLIGHT_CONTROL_INTERVAL_MS);
+
+        // Luminaire dims to at most 10 %, above that daylight alone exceeds the setpoint
+        uint32_t lowest_light = LUMINAIRE_CENTILUX * DAYLIGHT_TRIM_MIN / DAYLIGHT_TRIM_ONE;
+        if (Daylight + lowest_light <= SETPOINT_CENTILUX - TRACKING_ERROR_MAX_CENTILUX)
+        {
+            max_error = max(max_error, abs((int32_t)ReadAmbientLightCentilux() - (int32_t)SETPOINT_CENTILUX));
+        }
+        lowest_trim = min(lowest_trim, DaylightTrim);
+    }
+
+    printf("Daylight ramp: max error %d centilux, lowest trim %.1f %%\n", max_error, lowest_trim * 100.0 / DAYLIGHT_TRIM_ONE);
+    CHECK(max_error <= TRACKING_ERROR_MAX_CENTILUX);
+    CHECK(lowest_trim == DAYLIGHT_TRIM_MIN);
+}
+
+int main(void)
+{
+    SetupLightnessServer();
+    SetLightnessServerIdx(0, LC_SERVER_IDX);
+    SetLightCTLSupport(false);
+
+    TestSetpointFromMesh();
+    TestSetpointStep();
+    TestDaylightRamp();
+
+    return Test_Result();
+}
@@ -0,0 +1,194 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host test of DFU image decoder with flash simulated by FlashBackendFile.cpp.
+ *  Build and run with 'make test'.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DfuImage.h"
+#include "Flasher.h"
+#include "Test.h"
+
+
+#define FLASH_FILE_PATH "_build_test/flash.bin" /**< Simulated flash file */
+#define FIRMWARE_SIZE 0x2000u                   /**< Size of simulated running firmware */
+#define IMAGE_SIZE 0x600u                       /**< Size of decoded test image */
+#define DELTA_OP_INSERT 0x00u
+#define DELTA_OP_COPY 0x01u
+
+
+static uint8_t Image[2 * IMAGE_SIZE]; /**< Encoded test image */
+static uint8_t Expected[IMAGE_SIZE];  /**< Decoded test image */
+static size_t  ImageLen    = 0;
+static size_t  ExpectedLen = 0;
+
+
+/*
+ *  Value of running firmware byte
+ *
+ *  @param offset    Offset in running firmware
+ *  @return          Byte value
+ */
+static uint8_t FirmwareByte(size_t offset)
+{
+    return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+/*
+ *  Start encoded delta image
+ */
+static void ImageStart(void)
+{
+    const uint8_t header[] = {'S', 'D', 'F', 'U', DFU_IMAGE_FORMAT_DELTA, 0, 0, 0};
+
+    memcpy(Image, header, sizeof(header));
+    ImageLen    = sizeof(header) + sizeof(uint32_t);
+    ExpectedLen = 0;
+}
+
+/*
+ *  Finish encoded delta image, write decoded size to header
+ */
+static void ImageFinish(void)
+{
+    Image[8]  = (uint8_t)ExpectedLen;
+    Image[9]  = (uint8_t)(ExpectedLen >> 8);
+    Image[10] = (uint8_t)(ExpectedLen >> 16);
+    Image[11] = (uint8_t)(ExpectedLen >> 24);
+}
+
+/*
+ *  Append insert operation
+ *
+ *  @param len       Number of inserted bytes
+ */
+static void ImageInsert(size_t len)
+{
+    Image[ImageLen++] = DELTA_OP_INSERT;
+    Image[ImageLen++] = (uint8_t)len;
+    Image[ImageLen++] = (uint8_t)(len >> 8);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        Image[ImageLen++]       = (uint8_t)(0xA5 ^ i);
+        Expected[ExpectedLen++] = (uint8_t)(0xA5 ^ i);
+    }
+}
+
+/*
+ *  Append copy operation
+ *
+ *  @param source    Offset in running firmware
+ *  @param len       Number of copied bytes
+ */
+static void ImageCopy(size_t source, size_t len)
+{
+    Image[ImageLen++] = DELTA_OP_COPY;
+    Image[ImageLen++] = (uint8_t)source;
+    Image[ImageLen++] = (uint8_t)(source >> 8);
+    Image[ImageLen++] = (uint8_t)(source >> 16);
+    Image[ImageLen++] = (uint8_t)len;
+    Image[ImageLen++] = (uint8_t)(len >> 8);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        Expected[ExpectedLen++] = FirmwareByte(source + i);
+    }
+}
+
+/*
+ *  Create simulated flash with running firmware and erased DFU space
+ */
+static void SetupFlash(void)
+{
+    unlink(FLASH_FILE_PATH);
+    CHECK(FlashBackend_Open(FLASH_FILE_PATH, FIRMWARE_SIZE, 0, 0) == FLASHER_SUCCESS);
+
+    uint8_t *p_flash = (uint8_t *)(uintptr_t)FLASH_BASE_ADDR;
+    for (size_t i = 0; i < FIRMWARE_SIZE; i++)
+    {
+        p_flash[i] = FirmwareByte(i);
+    }
+
+    CHECK(Flasher_EraseSpace() == FLASHER_SUCCESS);
+    DfuImage_Init();
+}
+
+/*
+ *  Copy operations read running firmware through flash mapping and are decoded into DFU space
+ */
+static void TestDeltaCopy(void)
+{
+    SetupFlash();
+
+    ImageStart();
+    ImageInsert(5);
+    ImageCopy(0x100, 0x300);
+    ImageInsert(3);
+    ImageCopy(0, 0x40);
+    ImageCopy(FIRMWARE_SIZE - 0x100, 0x100);
+    ImageFinish();
+
+    // Image is sent in pages, operations are split between them
+    size_t page = 64;
+    for (size_t offset = 0; offset < ImageLen; offset += page)
+    {
+        size_t len = (ImageLen - offset < page) ? ImageLen - offset : page;
+        CHECK(DfuImage_Write(Image + offset, len) == DFU_IMAGE_SUCCESS);
+    }
+    CHECK(DfuImage_Finish() == DFU_IMAGE_SUCCESS);
+    CHECK(DfuImage_GetSize() == ExpectedLen);
+    CHECK(memcmp((const void *)(uintptr_t)Flasher_GetSpaceAddr(), Expected, ExpectedLen) == 0);
+
+    FlashBackend_Close();
+}
+
+/*
+ *  Copy operation reaching into DFU space is rejected
+ */
+static void TestDeltaCopyOutOfFirmware(void)
+{
+    SetupFlash();
+
+    size_t space_offset = Flasher_GetSpaceAddr() - FLASH_BASE_ADDR;
+
+    ImageStart();
+    ImageCopy(space_offset - 0x10, 0x20);
+    ImageFinish();
+
+    CHECK(DfuImage_Write(Image, ImageLen) == DFU_IMAGE_ERROR_FORMAT);
+
+    FlashBackend_Close();
+}
+
+int main(void)
+{
+    TestDeltaCopy();
+    TestDeltaCopyOutOfFirmware();
+
+    return Test_Result();
+}
@@ -0,0 +1,881 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host end to end test of DFU. Scripted modem exchanges UART frames with UARTProtocol.cpp and MCU_DFU.cpp,
+ *  flash is simulated by FlashBackendFile.cpp. Restart after firmware update exits the process, so every
+ *  update runs in a forked MCU process and the test process checks the flash it left.
+ *  Frames are timed by UART speed, modem turnaround and flash programming, so transfer with pages and
+ *  windowed transfer can be compared. Build and run with 'make test'.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+#include "CRC.h"
+#include "Config.h"
+#include "DfuImage.h"
+#include "FlashBackend.h"
+#include "Flasher.h"
+#include "KVStore.h"
+#include "MCU_DFU.h"
+#include "MCU_Health.h"
+#include "Scratch.h"
+#include "Test.h"
+#include "UARTDriver.h"
+#include "UARTProtocol.h"
+
+
+#define FLASH_FILE_PATH "_build_test/dfu_flash.bin" /**< Simulated flash file */
+#define FIRMWARE_SIZE 0x3000u                       /**< Size of simulated running firmware */
+#define IMAGE_SIZE 0x2C10u                          /**< Size of new firmware, last page is not full */
+#define SCRATCH_SIZE 1152u                          /**< Simulated free RAM, fits 1 KB page and its window map */
+#define CONFIG_FIELD_OFFSET 0x40u                   /**< Flash config field, left erased by Flasher */
+#define SCRUB_INTERVAL_MS 60000u /**< Integrity check interval of MCU_DFU.cpp */
+
+/**< UART frame description */
+#define FRAME_PREAMBLE_1 0xAAu
+#define FRAME_PREAMBLE_2 0x55u
+#define FRAME_OVERHEAD 6u /**< Preamble (2), length, command, CRC (2) */
+#define UART_QUEUE_SIZE 1024u
+
+/**< DFU commands */
+#define CMD_DFU_INIT_REQ 0x80u
+#define CMD_DFU_INIT_RESP 0x81u
+#define CMD_DFU_STATUS_REQ 0x82u
+#define CMD_DFU_STATUS_RESP 0x83u
+#define CMD_DFU_PAGE_CREATE_REQ 0x84u
+#define CMD_DFU_PAGE_CREATE_RESP 0x85u
+#define CMD_DFU_WRITE_DATA_EVENT 0x86u
+#define CMD_DFU_PAGE_STORE_REQ 0x87u
+#define CMD_DFU_PAGE_STORE_RESP 0x88u
+#define CMD_DFU_WINDOW_WRITE_EVENT 0x8Du
+#define CMD_DFU_WINDOW_ACK_EVENT 0x8Eu
+
+/**< DFU status codes */
+#define DFU_SUCCESS 0x01u
+#define DFU_FIRMWARE_SUCCESSFULLY_UPDATED 0xFFu
+
+#define WRITE_DATA_MAX_LEN (MAX_PAYLOAD_SIZE - 1) /**< Write Data Event carries length byte and data */
+#define RESUME_PAGES 5u                           /**< Pages sent before simulated reset */
+#define RESUME_OFFSET 4096u                       /**< Progress is saved once per 4 KB */
+
+/**< Windowed transfer */
+#define WINDOW_WRITE_HEADER_LEN 5u                                  /**< Image offset (4), data length */
+#define WINDOW_WRITE_MAX_LEN (MAX_PAYLOAD_SIZE - WINDOW_WRITE_HEADER_LEN) /**< Data in one Window Write Event */
+#define WINDOW_ACK_LEN 10u                                          /**< Status, offset (4), CRC (4), received pages */
+#define WINDOW_PAGES 4u                                             /**< Pages in flight, as in MCU_DFU.cpp */
+#define WINDOW_LOSS_INTERVAL 17u                                    /**< Every this many chunk is lost in lossy test */
+
+/**< Timing model */
+#define UART_BYTE_US 174u              /**< 10 bits at 57600 baud */
+#define UART_RX_BUFFER_LEN 512u        /**< DMA receive buffer of UARTDriver.cpp */
+#define MODEM_TURNAROUND_US 1000u      /**< Assumed delay between response received by modem and its next request */
+#define MODEM_RETRY_TIMEOUT_US 200000u /**< Modem resends missing pages if no ack arrives */
+#define MODEM_GIVE_UP_US 60000000u     /**< Modem script fails if transfer takes longer */
+#define FLASH_PROGRAM_WORD_US 65u      /**< Assumed KL26 longword program time */
+#define TX_FRAMES_MAX 64u              /**< Frames sent by MCU, not yet taken by modem */
+
+
+/*
+ *  Report of forked MCU process, shared with test process
+ */
+typedef struct
+{
+    uint64_t transfer_us; /**< From MCU start to restart after update */
+    uint32_t max_backlog; /**< Maximal number of bytes waiting in receive buffer while MCU was busy */
+} McuReport_T;
+
+
+static uint8_t Image[IMAGE_SIZE];
+static uint8_t ImageSha256[32];
+
+static uint8_t RxQueue[UART_QUEUE_SIZE]; /**< Modem to MCU */
+static size_t  RxHead = 0;
+static size_t  RxTail = 0;
+static uint8_t TxQueue[UART_QUEUE_SIZE]; /**< MCU to modem */
+static size_t  TxHead = 0;
+static size_t  TxTail = 0;
+
+static uint64_t TxFrameUs[TX_FRAMES_MAX]; /**< Arrival time of frames in TxQueue at modem */
+static size_t   TxFrameHead = 0;
+static size_t   TxFrameTail = 0;
+static size_t   TxTimed     = 0; /**< Bytes of TxQueue with known arrival time */
+
+static uint64_t     ModemUs        = 0; /**< Modem clock, link to MCU is free from this time */
+static uint64_t     McuUs          = 0; /**< MCU has processed all received frames at this time */
+static uint64_t     McuTxUs        = 0; /**< Link to modem is free from this time */
+static uint64_t     BootUs         = 0;
+static size_t       ProgrammedSize = 0; /**< Image bytes programmed before current frame */
+static McuReport_T *p_Report       = NULL;
+
+static uint8_t ScratchArena[SCRATCH_SIZE];
+static bool    ScratchInUse = false;
+
+static uint8_t ReportedFaultId = 0;
+
+
+/*
+ *  Scratch.cpp takes the arena from the gap between heap and stack of the target,
+ *  on the host the arena is a fixed buffer of simulated free RAM size.
+ */
+size_t Scratch_GetAvailable(void)
+{
+    return ScratchInUse ? 0 : SCRATCH_SIZE;
+}
+
+uint8_t *Scratch_Acquire(size_t size)
+{
+    if (ScratchInUse || size > SCRATCH_SIZE)
+    {
+        return NULL;
+    }
+
+    ScratchInUse = true;
+    return ScratchArena;
+}
+
+void Scratch_Release(void)
+{
+    ScratchInUse = false;
+}
+
+/*
+ *  UART driver connected to the scripted modem
+ */
+void UARTDriver_Init(void)
+{
+}
+
+bool UARTDriver_WriteBytes(uint8_t *table, uint16_t len)
+{
+    if (TxTail + len > UART_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(TxQueue + TxTail, table, len);
+    TxTail += len;
+    return true;
+}
+
+bool UARTDriver_ReadByte(uint8_t *read_byte)
+{
+    if (RxHead == RxTail)
+    {
+        return false;
+    }
+
+    *read_byte = RxQueue[RxHead++];
+    return true;
+}
+
+void UARTDriver_RxDMAPoll(void)
+{
+}
+
+/*
+ *  Commands not used by DFU
+ */
+void ProcessEnterInitDevice(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessEnterDevice(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessEnterInitNode(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessEnterNode(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessMeshCommand(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessAttention(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessError(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessStartTest(uint8_t *p_payload, uint8_t len)
+{
+}
+
+void ProcessFirmwareVersionSetResponse(void)
+{
+}
+
+uint8_t GetHealthServerIdx(void)
+{
+    return 0;
+}
+
+void MCU_Health_SendSetFaultRequest(uint16_t company_id, uint8_t fault_id, uint8_t instance_idx)
+{
+    ReportedFaultId = fault_id;
+}
+
+/*
+ *  Value of running firmware byte
+ *
+ *  @param offset    Offset in running firmware
+ *  @return          Byte value
+ */
+static uint8_t FirmwareByte(size_t offset)
+{
+    return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+/*
+ *  Create new firmware image and its SHA256
+ */
+static void CreateImage(void)
+{
+    for (size_t i = 0; i < IMAGE_SIZE; i++)
+    {
+        Image[i] = (uint8_t)(i * 13 + (i >> 9));
+    }
+
+    // Flasher doesn't program config field of copied firmware, so image keeps it erased.
+    memset(Image + CONFIG_FIELD_OFFSET, 0xFF, sizeof(uint32_t));
+
+    CalcSHA256(Image, IMAGE_SIZE, ImageSha256);
+}
+
+/*
+ *  Start MCU: map simulated flash, initialize key value store and DFU
+ *
+ *  @param firmware_size    Size of running firmware
+ */
+static void Mcu_Boot(size_t firmware_size)
+{
+    CHECK(FlashBackend_Open(FLASH_FILE_PATH, firmware_size, 0, 0) == FLASHER_SUCCESS);
+    KVStore_Init();
+    SetupDFU();
+
+    RxHead = RxTail = 0;
+    TxHead = TxTail = 0;
+    TxFrameHead = TxFrameTail = TxTimed = 0;
+
+    BootUs         = (uint64_t)Host_Millis * 1000;
+    ModemUs        = BootUs;
+    McuUs          = BootUs;
+    McuTxUs        = BootUs;
+    ProgrammedSize = 0;
+    memset(p_Report, 0, sizeof(*p_Report));
+}
+
+/*
+ *  Create simulated flash with running firmware and start MCU
+ */
+static void Mcu_PowerOn(void)
+{
+    FlashBackend_Close();
+    unlink(FLASH_FILE_PATH);
+    Mcu_Boot(FIRMWARE_SIZE);
+
+    uint8_t *p_flash = (uint8_t *)(uintptr_t)FLASH_BASE_ADDR;
+    for (size_t i = 0; i < FIRMWARE_SIZE; i++)
+    {
+        p_flash[i] = FirmwareByte(i);
+    }
+}
+
+/*
+ *  Exit handler of forked MCU process, failed checks are reported in exit code
+ */
+static void Mcu_Exit(void)
+{
+    // Restart happens while last frame is processed, after its page has been programmed.
+    uint64_t program_us   = (DfuImage_GetSize() - ProgrammedSize) / sizeof(uint32_t) * FLASH_PROGRAM_WORD_US;
+    p_Report->transfer_us = McuUs + program_us - BootUs;
+
+    fflush(stdout);
+    if (Failures != 0)
+    {
+        _exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ *  Run modem script in forked MCU process
+ *
+ *  @param p_script  Modem script, expected to end with firmware update
+ *  @return          True if MCU restarted after firmware update and all checks passed
+ */
+static bool Mcu_RunUntilRestart(void (*p_script)(void))
+{
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        atexit(Mcu_Exit);
+        p_script();
+
+        // Script returned, so firmware was not updated.
+        fflush(stdout);
+        _exit(EXIT_FAILURE);
+    }
+
+    int status;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/*
+ *  Send frame to MCU and let it process all received bytes
+ *
+ *  @param cmd       Command
+ *  @param p_payload Payload
+ *  @param len       Payload length
+ */
+static void Modem_Send(uint8_t cmd, const uint8_t *p_payload, uint8_t len)
+{
+    uint16_t crc = CRC16_INIT_VAL;
+    crc          = CalcCRC16(&len, sizeof(len), crc);
+    crc          = CalcCRC16(&cmd, sizeof(cmd), crc);
+    crc          = CalcCRC16((uint8_t *)p_payload, len, crc);
+
+    RxHead = RxTail = 0;
+
+    RxQueue[RxTail++] = FRAME_PREAMBLE_1;
+    RxQueue[RxTail++] = FRAME_PREAMBLE_2;
+    RxQueue[RxTail++] = len;
+    RxQueue[RxTail++] = cmd;
+    memcpy(RxQueue + RxTail, p_payload, len);
+    RxTail += len;
+    RxQueue[RxTail++] = lowByte(crc);
+    RxQueue[RxTail++] = highByte(crc);
+
+    // Frame is processed when its last byte arrives, or later if MCU is still programming flash.
+    // Modem keeps sending meanwhile, so everything it sends until then waits in receive buffer.
+    ModemUs += RxTail * UART_BYTE_US;
+    if (McuUs > ModemUs)
+    {
+        uint32_t backlog = RxTail + (McuUs - ModemUs) / UART_BYTE_US;
+        if (backlog > p_Report->max_backlog)
+        {
+            p_Report->max_backlog = backlog;
+        }
+    }
+    else
+    {
+        McuUs = ModemUs;
+    }
+    Host_Millis = McuUs / 1000;
+
+    ProgrammedSize = DfuImage_GetSize();
+    while (RxHead != RxTail)
+    {
+        UART_ProcessIncomingCommand();
+    }
+
+    if (DfuImage_GetSize() > ProgrammedSize)
+    {
+        McuUs += (DfuImage_GetSize() - ProgrammedSize) / sizeof(uint32_t) * FLASH_PROGRAM_WORD_US;
+    }
+    ProgrammedSize = DfuImage_GetSize();
+
+    while (TxTimed < TxTail && TxFrameTail < TX_FRAMES_MAX)
+    {
+        size_t frame_len = FRAME_OVERHEAD + TxQueue[TxTimed + 2];
+
+        McuTxUs                  = ((McuTxUs > McuUs) ? McuTxUs : McuUs) + frame_len * UART_BYTE_US;
+        TxFrameUs[TxFrameTail++] = McuTxUs;
+        TxTimed += frame_len;
+    }
+}
+
+/*
+ *  Take next frame sent by MCU
+ *
+ *  @param p_payload [out] Payload, at least MAX_PAYLOAD_SIZE bytes
+ *  @param p_len     [out] Payload length
+ *  @param wait      Wait for frame still being sent, otherwise take only frame which has already arrived
+ *  @return          Command, 0 if there is no frame to take
+ */
+static uint8_t Modem_Receive(uint8_t *p_payload, uint8_t *p_len, bool wait)
+{
+    if (TxFrameHead == TxFrameTail || (!wait && TxFrameUs[TxFrameHead] > ModemUs))
+    {
+        return 0;
+    }
+
+    if (TxFrameUs[TxFrameHead] > ModemUs)
+    {
+        ModemUs = TxFrameUs[TxFrameHead];
+    }
+    TxFrameHead++;
+
+    uint8_t *p_frame = TxQueue + TxHead;
+    uint8_t  len     = p_frame[2];
+    uint8_t  cmd     = p_frame[3];
+
+    uint16_t crc = CRC16_INIT_VAL;
+    crc          = CalcCRC16(&p_frame[2], 2, crc);
+    crc          = CalcCRC16(&p_frame[4], len, crc);
+
+    CHECK(p_frame[0] == FRAME_PREAMBLE_1 && p_frame[1] == FRAME_PREAMBLE_2);
+    CHECK(p_frame[4 + len] == lowByte(crc) && p_frame[5 + len] == highByte(crc));
+
+    memcpy(p_payload, p_frame + 4, len);
+    *p_len = len;
+
+    TxHead += FRAME_OVERHEAD + len;
+    if (TxHead == TxTail)
+    {
+        TxHead = TxTail = TxTimed = 0;
+        TxFrameHead = TxFrameTail = 0;
+    }
+
+    return cmd;
+}
+
+/*
+ *  Send request and take response status
+ *
+ *  @param cmd       Request command
+ *  @param p_payload Request payload
+ *  @param len       Request payload length
+ *  @param resp_cmd  Expected response command
+ *  @return          First byte of response payload
+ */
+static uint8_t Modem_Request(uint8_t cmd, const uint8_t *p_payload, uint8_t len, uint8_t resp_cmd)
+{
+    uint8_t response[MAX_PAYLOAD_SIZE];
+    uint8_t response_len = 0;
+
+    Modem_Send(cmd, p_payload, len);
+    CHECK(Modem_Receive(response, &response_len, true) == resp_cmd);
+    CHECK(response_len >= 1);
+    ModemUs += MODEM_TURNAROUND_US;
+
+    return response[0];
+}
+
+/*
+ *  Send DFU Init Request of the new image
+ *
+ *  @return          DFU status code
+ */
+static uint8_t Modem_Init(void)
+{
+    uint8_t payload[4 + sizeof(ImageSha256) + 1 + sizeof(DFU_VALIDATION_STRING) - 1];
+    size_t  index = 0;
+
+    payload[index++] = (uint8_t)IMAGE_SIZE;
+    payload[index++] = (uint8_t)(IMAGE_SIZE >> 8);
+    payload[index++] = (uint8_t)(IMAGE_SIZE >> 16);
+    payload[index++] = (uint8_t)(IMAGE_SIZE >> 24);
+
+    // SHA256 is sent in reversed byte order.
+    for (size_t i = 0; i < sizeof(ImageSha256); i++)
+    {
+        payload[index++] = ImageSha256[sizeof(ImageSha256) - i - 1];
+    }
+
+    payload[index++] = sizeof(DFU_VALIDATION_STRING) - 1;
+    memcpy(payload + index, DFU_VALIDATION_STRING, sizeof(DFU_VALIDATION_STRING) - 1);
+
+    return Modem_Request(CMD_DFU_INIT_REQ, payload, sizeof(payload), CMD_DFU_INIT_RESP);
+}
+
+/*
+ *  Send DFU Status Request
+ *
+ *  @param p_max_page [out] Maximal page size
+ *  @param p_offset   [out] Offset of received data
+ *  @param p_crc      [out] CRC32 of received data
+ */
+static void Modem_Status(uint32_t *p_max_page, uint32_t *p_offset, uint32_t *p_crc)
+{
+    uint8_t response[MAX_PAYLOAD_SIZE];
+    uint8_t response_len = 0;
+
+    Modem_Send(CMD_DFU_STATUS_REQ, NULL, 0);
+    CHECK(Modem_Receive(response, &response_len, true) == CMD_DFU_STATUS_RESP);
+    CHECK(response_len == 13 && response[0] == DFU_SUCCESS);
+    ModemUs += MODEM_TURNAROUND_US;
+
+    uint32_t words[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        const uint8_t *p_word = response + 1 + 4 * i;
+        words[i] = p_word[0] | (p_word[1] << 8) | (p_word[2] << 16) | ((uint32_t)p_word[3] << 24);
+    }
+
+    *p_max_page = words[0];
+    *p_offset   = words[1];
+    *p_crc      = words[2];
+}
+
+/*
+ *  Send image with PageCreate / WriteData / PageStore sequence
+ *
+ *  @param from      First image offset to send
+ *  @param to        Image offset after last sent byte
+ *  @param page_size Page size
+ *  @return          Status of last Page Store Response
+ */
+static uint8_t Modem_SendPages(size_t from, size_t to, size_t page_size)
+{
+    uint8_t status = DFU_SUCCESS;
+
+    for (size_t page = from; page < to && status == DFU_SUCCESS; page += page_size)
+    {
+        uint32_t len = (to - page < page_size) ? to - page : page_size;
+
+        uint8_t create[] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24)};
+        CHECK(Modem_Request(CMD_DFU_PAGE_CREATE_REQ, create, sizeof(create), CMD_DFU_PAGE_CREATE_RESP) == DFU_SUCCESS);
+
+        for (size_t offset = page; offset < page + len; offset += WRITE_DATA_MAX_LEN)
+        {
+            uint8_t data[MAX_PAYLOAD_SIZE];
+            uint8_t data_len = (page + len - offset < WRITE_DATA_MAX_LEN) ? page + len - offset : WRITE_DATA_MAX_LEN;
+
+            data[0] = data_len;
+            memcpy(data + 1, Image + offset, data_len);
+            Modem_Send(CMD_DFU_WRITE_DATA_EVENT, data, data_len + 1);
+        }
+
+        status = Modem_Request(CMD_DFU_PAGE_STORE_REQ, NULL, 0, CMD_DFU_PAGE_STORE_RESP);
+    }
+
+    return status;
+}
+
+/*
+ *  Take window acks which have already arrived
+ *
+ *  @param p_acked    [in, out] Committed offset
+ *  @param p_received [in, out] Completely received pages after committed offset
+ */
+static void Modem_TakeWindowAcks(size_t *p_acked, uint8_t *p_received)
+{
+    uint8_t ack[MAX_PAYLOAD_SIZE];
+    uint8_t ack_len;
+    uint8_t cmd;
+
+    while ((cmd = Modem_Receive(ack, &ack_len, false)) != 0)
+    {
+        CHECK(cmd == CMD_DFU_WINDOW_ACK_EVENT && ack_len == WINDOW_ACK_LEN && ack[0] == DFU_SUCCESS);
+
+        uint32_t offset = ack[1] | (ack[2] << 8) | (ack[3] << 16) | ((uint32_t)ack[4] << 24);
+        uint32_t crc    = ack[5] | (ack[6] << 8) | (ack[7] << 16) | ((uint32_t)ack[8] << 24);
+        CHECK(offset <= IMAGE_SIZE && crc == CalcCRC32(Image, offset, CRC32_INIT_VAL));
+
+        *p_acked    = offset;
+        *p_received = ack[9];
+    }
+}
+
+/*
+ *  Send image with Window Write Events. Modem streams pages after committed offset without waiting,
+ *  skips pages reported as received and resends missing ones when no ack arrives.
+ *
+ *  @param page_size     Maximal page size reported by MCU, split between pages in flight
+ *  @param loss_interval Every this many chunk is lost, 0 for lossless link
+ */
+static void Modem_SendWindowed(size_t page_size, size_t loss_interval)
+{
+    size_t  window_page = page_size / WINDOW_PAGES;
+    size_t  acked       = 0;
+    uint8_t received    = 0;
+    size_t  next        = 0;
+    size_t  chunks      = 0;
+
+    // Last chunk restarts MCU, so loop ends only if transfer doesn't complete.
+    while (ModemUs - BootUs < MODEM_GIVE_UP_US)
+    {
+        Modem_TakeWindowAcks(&acked, &received);
+
+        size_t window_end = acked + WINDOW_PAGES * window_page;
+        if (window_end > IMAGE_SIZE)
+        {
+            window_end = IMAGE_SIZE;
+        }
+
+        if (next < acked)
+        {
+            next = acked;
+        }
+        while (next < window_end && (received & (1u << ((next - acked) / window_page))))
+        {
+            next = acked + ((next - acked) / window_page + 1) * window_page;
+        }
+
+        if (next >= window_end)
+        {
+            // Window is full, wait for next ack or resend missing pages if there is none.
+            if (TxFrameHead != TxFrameTail)
+            {
+                ModemUs = (TxFrameUs[TxFrameHead] > ModemUs) ? TxFrameUs[TxFrameHead] : ModemUs;
+            }
+            else
+            {
+                ModemUs += MODEM_RETRY_TIMEOUT_US;
+                next = acked;
+            }
+            continue;
+        }
+
+        // Chunk may span pages, up to next page already received.
+        size_t chunk_end = (window_end - next > WINDOW_WRITE_MAX_LEN) ? next + WINDOW_WRITE_MAX_LEN : window_end;
+        for (size_t page = (next - acked) / window_page + 1; acked + page * window_page < chunk_end; page++)
+        {
+            if (received & (1u << page))
+            {
+                chunk_end = acked + page * window_page;
+                break;
+            }
+        }
+        size_t len = chunk_end - next;
+
+        uint8_t data[MAX_PAYLOAD_SIZE];
+        data[0] = (uint8_t)next;
+        data[1] = (uint8_t)(next >> 8);
+        data[2] = (uint8_t)(next >> 16);
+        data[3] = (uint8_t)(next >> 24);
+        data[4] = (uint8_t)len;
+        memcpy(data + WINDOW_WRITE_HEADER_LEN, Image + next, len);
+
+        chunks++;
+        if (loss_interval != 0 && chunks % loss_interval == 0)
+        {
+            ModemUs += (FRAME_OVERHEAD + WINDOW_WRITE_HEADER_LEN + len) * UART_BYTE_US;
+        }
+        else
+        {
+            Modem_Send(CMD_DFU_WINDOW_WRITE_EVENT, data, WINDOW_WRITE_HEADER_LEN + len);
+        }
+        next += len;
+    }
+
+    CHECK(!"Windowed transfer not completed");
+}
+
+/*
+ *  Modem script: whole image in pages of maximal size
+ */
+static void Script_Update(void)
+{
+    uint32_t max_page, offset, crc;
+
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    Modem_Status(&max_page, &offset, &crc);
+    CHECK(max_page == 1024 && offset == 0);
+
+    // Last page store validates image and copies it over running firmware, it doesn't return.
+    Modem_SendPages(0, IMAGE_SIZE, max_page);
+}
+
+/*
+ *  Modem script: image sent after reset from offset reported by MCU
+ */
+static void Script_Resume(void)
+{
+    uint32_t max_page, offset, crc;
+
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    Modem_Status(&max_page, &offset, &crc);
+    CHECK(offset == RESUME_OFFSET);
+    CHECK(crc == CalcCRC32(Image, RESUME_OFFSET, CRC32_INIT_VAL));
+
+    Modem_SendPages(offset, IMAGE_SIZE, max_page);
+}
+
+/*
+ *  Modem script: whole image in window over lossless link
+ */
+static void Script_WindowUpdate(void)
+{
+    uint32_t max_page, offset, crc;
+
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    Modem_Status(&max_page, &offset, &crc);
+    Modem_SendWindowed(max_page, 0);
+}
+
+/*
+ *  Modem script: whole image in window, some chunks are lost
+ */
+static void Script_WindowLoss(void)
+{
+    uint32_t max_page, offset, crc;
+
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    Modem_Status(&max_page, &offset, &crc);
+    Modem_SendWindowed(max_page, WINDOW_LOSS_INTERVAL);
+}
+
+/*
+ *  Check that new firmware runs after restart and passes integrity check
+ */
+static void CheckUpdatedFirmware(void)
+{
+    Mcu_Boot(IMAGE_SIZE);
+    CHECK(memcmp((const void *)(uintptr_t)FLASH_BASE_ADDR, Image, IMAGE_SIZE) == 0);
+
+    ReportedFaultId = 0;
+    Host_Millis += SCRUB_INTERVAL_MS;
+    LoopDFU();
+    CHECK(ReportedFaultId == 0);
+
+    FlashBackend_Close();
+}
+
+/*
+ *  Image sent page by page replaces running firmware
+ */
+static void TestPageUpdate(void)
+{
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_Update));
+    CheckUpdatedFirmware();
+}
+
+/*
+ *  Transfer interrupted by reset continues from last saved progress
+ */
+static void TestResumeAfterReset(void)
+{
+    Mcu_PowerOn();
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    CHECK(Modem_SendPages(0, RESUME_PAGES * 1024, 1024) == DFU_SUCCESS);
+
+    Mcu_Boot(FIRMWARE_SIZE);
+    CHECK(Mcu_RunUntilRestart(Script_Resume));
+    CheckUpdatedFirmware();
+}
+
+/*
+ *  Pages in flight are stored in order, also when chunks are lost and pages after missing one are complete
+ */
+static void TestWindowUpdate(void)
+{
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_WindowUpdate));
+    CheckUpdatedFirmware();
+
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_WindowLoss));
+    CheckUpdatedFirmware();
+}
+
+/*
+ *  Window Write Event shorter than its data length is dropped
+ */
+static void TestWindowInvalidLength(void)
+{
+    uint8_t data[WINDOW_WRITE_HEADER_LEN + 4] = {0, 0, 0, 0, 100};
+    uint8_t response[MAX_PAYLOAD_SIZE];
+    uint8_t response_len;
+
+    Mcu_PowerOn();
+    CHECK(Modem_Init() == DFU_SUCCESS);
+    Modem_Send(CMD_DFU_WINDOW_WRITE_EVENT, data, sizeof(data));
+    Modem_Send(CMD_DFU_WINDOW_WRITE_EVENT, data, WINDOW_WRITE_HEADER_LEN - 1);
+    CHECK(Modem_Receive(response, &response_len, true) == 0);
+
+    uint32_t max_page, offset, crc;
+    Modem_Status(&max_page, &offset, &crc);
+    CHECK(offset == 0);
+
+    FlashBackend_Close();
+}
+
+/*
+ *  Compare transfer time of pages and window, receive buffer has to hold data sent while MCU programs flash
+ */
+static void BenchmarkTransfer(void)
+{
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_Update));
+    McuReport_T pages = *p_Report;
+
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_WindowUpdate));
+    McuReport_T window = *p_Report;
+
+    FlashBackend_Close();
+
+    printf("Transfer of %u bytes: pages %u ms, window %u ms, speed-up %.2f\n",
+           IMAGE_SIZE,
+           (unsigned)(pages.transfer_us / 1000),
+           (unsigned)(window.transfer_us / 1000),
+           (double)pages.transfer_us / window.transfer_us);
+    printf("Receive buffer backlog: pages %u bytes, window %u bytes\n", pages.max_backlog, window.max_backlog);
+
+    CHECK(window.transfer_us < pages.transfer_us);
+    CHECK(pages.max_backlog < UART_RX_BUFFER_LEN && window.max_backlog < UART_RX_BUFFER_LEN);
+}
+
+/*
+ *  Install is confirmed at first start, corrupted byte of updated firmware is found by next integrity check
+ */
+static void TestIntegrityCheck(void)
+{
+    Mcu_PowerOn();
+    CHECK(Mcu_RunUntilRestart(Script_Update));
+    Mcu_Boot(IMAGE_SIZE);
+
+    ReportedFaultId = 0;
+    ((uint8_t *)(uintptr_t)FLASH_BASE_ADDR)[IMAGE_SIZE / 2] ^= 0x01;
+    Host_Millis += SCRUB_INTERVAL_MS;
+    LoopDFU();
+    CHECK(ReportedFaultId != 0);
+
+    FlashBackend_Close();
+}
+
+int main(void)
+{
+    CreateImage();
+
+    p_Report = (McuReport_T *)mmap(NULL, sizeof(McuReport_T), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p_Report == MAP_FAILED)
+    {
+        return 1;
+    }
+
+    TestPageUpdate();
+    TestResumeAfterReset();
+    TestWindowUpdate();
+    TestWindowInvalidLength();
+    TestIntegrityCheck();
+    BenchmarkTransfer();
+
+    return Test_Result();
+}
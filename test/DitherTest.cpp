@@ -0,0 +1,190 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host simulation of temporal dithering: linearity of average PWM output at low lightness with and without
+ *  dithering, and host time of output update. Build and run with 'make test'.
+ */
+
+#include "Config.h"
+
+#undef ENABLE_DITHERING
+#define ENABLE_DITHERING 1
+
+#include "MCU_Lightness.cpp"
+
+#include <time.h>
+
+#include "Test.h"
+
+
+#define DITHER_UPDATES 256u       /**< Dimming interrupts per lightness level, 1.28 s */
+#define DITHER_WINDOW 8u          /**< Dimming interrupts averaged by eye, 40 ms */
+#define BENCHMARK_STEPS 10000000u /**< Number of measured output updates */
+
+
+int KVStore_Read(uint8_t key, void *p_value, size_t len)
+{
+    return KV_STORE_ERROR_NOT_FOUND;
+}
+
+int KVStore_Write(uint8_t key, const void *p_value, size_t len)
+{
+    return KV_STORE_SUCCESS;
+}
+
+void Mesh_SendLightLightnessGet(uint8_t instance_idx)
+{
+}
+
+
+/*
+ *  Step lightness through all levels with dithered duty, as in a slow fade, and compare average output of each level
+ *  with interpolated duty. Output without dithering drops the fraction.
+ */
+static void TestLinearity(void)
+{
+    uint32_t plain_levels    = 0;
+    uint32_t dithered_levels = 0;
+    double   plain_error     = 0.0;
+    double   dithered_error  = 0.0;
+    double   window_error    = 0.0;
+    uint32_t previous_plain  = 0;
+    uint32_t previous_sum    = 0;
+    bool     is_monotonic    = true;
+    uint16_t val             = 1;
+
+    CTLSupport = false;
+    for (; PwmTable.Lookup(val) < DITHER_DUTY_MAX; val++)
+    {
+        uint32_t duty       = PwmTable.Lookup(val);
+        double   exact      = duty / (double)(1u << LIGHTNESS_TABLE_FRACTION_BITS);
+        uint32_t plain      = duty >> LIGHTNESS_TABLE_FRACTION_BITS;
+        uint32_t sum        = 0;
+        uint32_t window_sum = 0;
+
+        for (uint32_t update = 0; update < DITHER_UPDATES; update++)
+        {
+            SetLightnessOutput(0, val);
+            sum += Host_AnalogOutput[PIN_PWM_COLD];
+            window_sum += Host_AnalogOutput[PIN_PWM_COLD];
+
+            if ((update + 1) % DITHER_WINDOW == 0)
+            {
+                window_error = max(window_error, fabs(window_sum / (double)DITHER_WINDOW - exact));
+                window_sum   = 0;
+            }
+        }
+
+        plain_error    = max(plain_error, fabs(plain - exact));
+        dithered_error = max(dithered_error, fabs(sum / (double)DITHER_UPDATES - exact));
+        plain_levels += (plain != previous_plain);
+        dithered_levels += (sum != previous_sum);
+        is_monotonic = is_monotonic && (sum >= previous_sum);
+
+        previous_plain = plain;
+        previous_sum   = sum;
+    }
+
+    printf("Lightness 1-%u: plain %u levels, max error %.2f counts, dithered %u levels, max error %.4f counts, "
+           "%.3f counts in %u ms\n",
+           val - 1,
+           plain_levels,
+           plain_error,
+           dithered_levels,
+           dithered_error,
+           window_error,
+           DITHER_WINDOW * DIMM_INTERRUPT_TIME_MS);
+
+    // Output sum of n updates is n times duty plus fraction carried in minus fraction carried out
+    CHECK(is_monotonic);
+    CHECK(dithered_levels > 4 * plain_levels);
+    CHECK(dithered_error <= 1.0 / DITHER_UPDATES);
+    CHECK(window_error < 1.0 / DITHER_WINDOW);
+}
+
+/*
+ *  Duty of DITHER_DUTY_MAX and above is not dithered, so dimming interrupt can stop
+ */
+static void TestNoDitherAbove(void)
+{
+    uint16_t val = 1;
+    while (PwmTable.Lookup(val) < DITHER_DUTY_MAX)
+    {
+        val++;
+    }
+
+    for (; val < UINT16_MAX - 257; val += 257)
+    {
+        IsDithering = false;
+        SetLightnessOutput(0, val);
+        CHECK(!IsDithering);
+        CHECK(Host_AnalogOutput[PIN_PWM_COLD] == (int)(PwmTable.Lookup(val) >> LIGHTNESS_TABLE_FRACTION_BITS));
+    }
+}
+
+/*
+ *  Measure host time of output update at low lightness
+ *
+ *  @param is_dithered   Update with dithering, otherwise fraction is dropped
+ *  @return              Nanoseconds per update
+ */
+static double BenchmarkOutput(bool is_dithered)
+{
+    struct timespec begin;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (uint32_t step = 0; step < BENCHMARK_STEPS; step++)
+    {
+        uint16_t val = step & 0xFFFu;
+
+        if (is_dithered)
+        {
+            SetLightnessOutput(0, val);
+        }
+        else
+        {
+            uint32_t warm;
+            uint32_t cold;
+            CalculateOutput(0, val, &warm, &cold);
+            analogWrite(PinWarm[0], warm >> LIGHTNESS_TABLE_FRACTION_BITS);
+            analogWrite(PinCold[0], cold >> LIGHTNESS_TABLE_FRACTION_BITS);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ns = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+    return elapsed_ns / BENCHMARK_STEPS;
+}
+
+int main(void)
+{
+    TestLinearity();
+    TestNoDitherAbove();
+
+    double plain_ns    = BenchmarkOutput(false);
+    double dithered_ns = BenchmarkOutput(true);
+    printf("Output update: %.1f ns, dithered %.1f ns (host)\n", plain_ns, dithered_ns);
+
+    return Test_Result();
+}
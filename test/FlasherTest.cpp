@@ -0,0 +1,226 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host test of saving pages to flash simulated by FlashBackendFile.cpp. Reports program commands and check
+ *  overhead of Flasher_SaveMemoryToFlash against saving word by word with Flasher_FlashWord, as pages
+ *  were saved before. Build and run with 'make test'.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FlashBackend.h"
+#include "Flasher.h"
+#include "Test.h"
+
+
+#define FLASH_FILE_PATH "_build_test/flasher_flash.bin" /**< Simulated flash file */
+#define FIRMWARE_SIZE 0x2000u                           /**< Size of simulated running firmware */
+#define PAGE_SIZE 1024u                                 /**< Image is saved in pages, as received by DFU */
+#define ERASED_WORD 0xFFFFFFFFu
+#define PROGRAM_WORD_US 65u /**< Typical KL26 program longword command time */
+#define BENCHMARK_RUNS 20u
+
+/**< Layout of synthetic Teensy LC sketch image */
+#define IMAGE_VECTORS_SIZE 0xC0u  /**< Vector table */
+#define IMAGE_CODE_START 0x410u   /**< Code follows flash config field, gap after vectors is erased */
+#define IMAGE_SKETCH_SIZE 0x6000u /**< 24 KB sketch */
+#define IMAGE_PADDED_SIZE 0x8000u /**< Same sketch padded with erased words to 32 KB */
+#define IMAGE_MAX_WORDS (IMAGE_PADDED_SIZE / 4)
+
+
+static uint32_t Image[IMAGE_MAX_WORDS];
+
+
+/*
+ *  Create synthetic sketch image. Code is pseudo random with zero and all ones literals.
+ *
+ *  @param size      Image size, words after sketch are erased padding
+ */
+static void CreateImage(size_t size)
+{
+    uint32_t seed = 12345;
+
+    for (size_t i = 0; i < size / 4; i++)
+    {
+        size_t offset = i * 4;
+        seed          = seed * 1103515245u + 12345u;
+
+        if (offset >= IMAGE_SKETCH_SIZE || (offset >= IMAGE_VECTORS_SIZE && offset < IMAGE_CODE_START))
+        {
+            Image[i] = ERASED_WORD;
+        }
+        else if (offset < IMAGE_VECTORS_SIZE)
+        {
+            Image[i] = (i == 0) ? 0x20001800u : (IMAGE_CODE_START + (seed >> 20)) | 1u;
+        }
+        else if ((seed >> 24) < 24)
+        {
+            Image[i] = 0;
+        }
+        else if ((seed >> 24) < 27)
+        {
+            Image[i] = ERASED_WORD;
+        }
+        else
+        {
+            Image[i] = seed ^ (seed >> 16);
+        }
+    }
+}
+
+/*
+ *  Count words of image with other than erased value
+ *
+ *  @param size      Image size
+ *  @return          Number of words
+ */
+static uint32_t CountProgrammedWords(size_t size)
+{
+    uint32_t count = 0;
+    for (size_t i = 0; i < size / 4; i++)
+    {
+        count += (Image[i] != ERASED_WORD);
+    }
+    return count;
+}
+
+/*
+ *  Save image to erased DFU space page by page
+ *
+ *  @param size      Image size
+ *  @param bulk      Save pages with Flasher_SaveMemoryToFlash, otherwise word by word with Flasher_FlashWord
+ *  @param p_ns      [out] Host time spent in saving
+ *  @return          Number of program commands
+ */
+static uint32_t SaveImage(size_t size, bool bulk, double *p_ns)
+{
+    uint32_t programs, erases, start_programs;
+    uint32_t space = Flasher_GetSpaceAddr();
+
+    CHECK(Flasher_EraseSpace() == FLASHER_SUCCESS);
+    FlashBackend_GetCommandCount(&start_programs, &erases);
+
+    struct timespec begin;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+    {
+        const uint32_t *p_page = Image + offset / 4;
+
+        if (bulk)
+        {
+            CHECK(Flasher_SaveMemoryToFlash(space + offset, p_page, PAGE_SIZE / 4) == FLASHER_SUCCESS);
+            continue;
+        }
+
+        for (size_t i = 0; i < PAGE_SIZE / 4; i++)
+        {
+            uint32_t address = space + offset + i * 4;
+            CHECK(*(const volatile uint32_t *)(uintptr_t)address == ERASED_WORD);
+            CHECK(Flasher_FlashWord(address, p_page[i], true) == FLASHER_SUCCESS);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *p_ns = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+
+    CHECK(memcmp((const void *)(uintptr_t)space, Image, size) == 0);
+
+    FlashBackend_GetCommandCount(&programs, &erases);
+    return programs - start_programs;
+}
+
+/*
+ *  Save image both ways, check that erased words are not programmed and report time
+ *
+ *  @param p_name    Image description
+ *  @param size      Image size
+ */
+static void ReportImage(const char *p_name, size_t size)
+{
+    CreateImage(size);
+
+    uint32_t programmed = CountProgrammedWords(size);
+    double   bulk_ns    = 0;
+    double   word_ns    = 0;
+    uint32_t bulk_programs, word_programs;
+
+    for (uint32_t run = 0; run < BENCHMARK_RUNS; run++)
+    {
+        double ns;
+        bulk_programs = SaveImage(size, true, &ns);
+        bulk_ns += ns;
+        word_programs = SaveImage(size, false, &ns);
+        word_ns += ns;
+    }
+
+    CHECK(bulk_programs == programmed);
+    CHECK(word_programs == programmed);
+
+    uint32_t words = size / 4;
+    printf("%s: %u words, %u erased, %u program commands (%u ms)\n",
+           p_name,
+           words,
+           words - programmed,
+           bulk_programs,
+           bulk_programs * PROGRAM_WORD_US / 1000);
+    printf("  checks: %.1f ns per word in pages, %.1f ns word by word (host)\n",
+           bulk_ns / BENCHMARK_RUNS / words,
+           word_ns / BENCHMARK_RUNS / words);
+}
+
+/*
+ *  Page is not saved over programmed words, nothing is programmed then
+ */
+static void TestNotErased(void)
+{
+    uint32_t space = Flasher_GetSpaceAddr();
+    uint32_t page[4] = {1, ERASED_WORD, 3, 4};
+    uint32_t start_programs, programs, erases;
+
+    CHECK(Flasher_EraseSpace() == FLASHER_SUCCESS);
+    CHECK(Flasher_SaveMemoryToFlash(space, page, 4) == FLASHER_SUCCESS);
+
+    FlashBackend_GetCommandCount(&start_programs, &erases);
+    CHECK(Flasher_SaveMemoryToFlash(space + 4, page, 2) == FLASHER_ERROR_NOT_ERASED);
+    FlashBackend_GetCommandCount(&programs, &erases);
+    CHECK(programs == start_programs);
+}
+
+int main(void)
+{
+    unlink(FLASH_FILE_PATH);
+    CHECK(FlashBackend_Open(FLASH_FILE_PATH, FIRMWARE_SIZE, 0, 0) == FLASHER_SUCCESS);
+
+    TestNotErased();
+    ReportImage("Sketch 24 KB", IMAGE_SKETCH_SIZE);
+    ReportImage("Sketch padded to 32 KB", IMAGE_PADDED_SIZE);
+
+    FlashBackend_Close();
+
+    return Test_Result();
+}
@@ -0,0 +1,375 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host test of lightness transition profiles against values calculated in double precision and of
+ *  linear transitions against the previous millis() based interpolation, with benchmarks of dimming
+ *  interrupt step and body. Build and run with 'make test', once for each profile selected with
+ *  TEST_TRANSITION_PROFILE.
+ */
+
+#include "Config.h"
+
+#undef TRANSITION_PROFILE
+#define TRANSITION_PROFILE TEST_TRANSITION_PROFILE
+
+#include "MCU_Lightness.cpp"
+
+#include <time.h>
+
+#include "Test.h"
+
+
+#define GOLDEN_TRANSITION_MS 10000u           /**< Transition time of golden tests */
+#define GOLDEN_LOW_LIGHTNESS 2048u            /**< Lightness covered by first segments of L* table */
+#define GOLDEN_ERROR_MAX_LINEAR 1.5           /**< Allowed error of linear profile in lightness counts */
+#define GOLDEN_ERROR_MAX_EASE 16.0            /**< Allowed error of ease in/out profile in lightness counts */
+#define GOLDEN_ERROR_MAX_PERCEPTUAL 100.0     /**< Allowed error of perceptual profile in lightness counts */
+#define GOLDEN_ERROR_MAX_PERCEPTUAL_LOW 360.0 /**< Allowed error of perceptual profile below GOLDEN_LOW_LIGHTNESS */
+#define GOLDEN_JUMP_MAX 5                     /**< Allowed lightness change of transition to present value */
+#define BENCHMARK_STEPS 10000000u             /**< Number of measured dimming interrupt steps */
+#define PREVIOUS_TRANSITIONS 1000u            /**< Number of random transitions compared with previous math */
+#define PREVIOUS_TIME_MIN_MS 10u              /**< Shortest random transition */
+#define PREVIOUS_TIME_MAX_MS 600000u          /**< Longest random transition */
+#define PREVIOUS_ERROR_MAX 3                  /**< Allowed difference from previous math in lightness counts */
+
+
+/*
+ *  Start and target lightness of golden transitions
+ */
+static const uint16_t GoldenTransitions[][2] = {
+    {0, UINT16_MAX},
+    {UINT16_MAX, 0},
+    {1, 2000},
+    {2000, 1},
+    {2000, UINT16_MAX},
+    {30000, 500},
+    {100, 101},
+    {40000, 39000},
+};
+
+
+int KVStore_Read(uint8_t key, void *p_value, size_t len)
+{
+    return KV_STORE_ERROR_NOT_FOUND;
+}
+
+int KVStore_Write(uint8_t key, const void *p_value, size_t len)
+{
+    return KV_STORE_SUCCESS;
+}
+
+void Mesh_SendLightLightnessGet(uint8_t instance_idx)
+{
+}
+
+static bool IsSoftDivision = false; /**< Previous math divides bit by bit, as on Cortex-M0+ */
+
+
+/*
+ *  Divide as previous math did, with host divider or bit by bit as on Cortex-M0+
+ *
+ *  @param dividend  Dividend
+ *  @param divisor   Divisor
+ *  @param bits      Width of division, 32 or 64
+ *  @return          Quotient
+ */
+static uint64_t Divide(uint64_t dividend, uint64_t divisor, uint32_t bits)
+{
+    return IsSoftDivision ? Test_SoftDivide(dividend, divisor, bits) : dividend / divisor;
+}
+
+/*
+ *  Lightness of linear transition as calculated by dimming interrupt before transitions were stepped
+ *  in fixed point: interpolation of time since start, read with millis()
+ *
+ *  @param start            Start lightness
+ *  @param target           Target lightness
+ *  @param transition_time  Transition time
+ *  @param delta_time       Time since transition start
+ *  @return                 Lightness
+ */
+static uint16_t PreviousPresentValue(uint16_t start, uint16_t target, uint32_t transition_time, uint32_t delta_time)
+{
+    if (delta_time > transition_time)
+    {
+        return target;
+    }
+
+    int64_t product          = ((int64_t)target - start) * delta_time;
+    int32_t delta_transition = (product < 0) ? -(int32_t)Divide(-product, transition_time, 64)
+                                             : (int32_t)Divide(product, transition_time, 64);
+
+    return start + delta_transition;
+}
+
+/*
+ *  PWM output as calculated by dimming interrupt before lightness table was introduced
+ *
+ *  @param val       Lightness
+ *  @return          PWM output
+ */
+static uint32_t PreviousOutput(uint16_t val)
+{
+    const uint32_t coefficient = ((uint32_t)(PWM_OUTPUT_MAX - PWM_OUTPUT_MIN) * UINT16_MAX) /
+                                 (LIGHTNESS_MAX - LIGHTNESS_MIN);
+
+    if (val == 0)
+    {
+        return 0;
+    }
+
+    uint32_t linear  = Divide((uint32_t)val * UINT8_MAX, LIGHTNESS_MAX, 32);
+    uint32_t pwm_out = Divide((uint32_t)LIGHTNESS_MAX * linear * linear, UINT16_MAX, 32);
+    return Divide(coefficient * (pwm_out - LIGHTNESS_MIN), UINT16_MAX, 32) + PWM_OUTPUT_MIN;
+}
+
+
+/*
+ *  Expected lightness of transition calculated in double precision
+ *
+ *  @param start     Start lightness
+ *  @param target    Target lightness
+ *  @param time      Normalized time, 0.0 - 1.0
+ *  @param profile   Transition profile
+ *  @return          Lightness
+ */
+static double ExpectedLightness(uint16_t start, uint16_t target, double time, TransitionProfile_T profile)
+{
+    double start_norm  = start / (double)UINT16_MAX;
+    double target_norm = target / (double)UINT16_MAX;
+
+    if (profile == TRANSITION_PROFILE_EASE_IN_OUT)
+    {
+        time = TransitionCurveEaseInOut::Linear(time);
+    }
+
+    if (profile == TRANSITION_PROFILE_PERCEPTUAL)
+    {
+        double start_l_star  = InverseCurve<LightnessCurveCIE1931>(LightnessCurve::Linear(start_norm));
+        double target_l_star = InverseCurve<LightnessCurveCIE1931>(LightnessCurve::Linear(target_norm));
+        double l_star        = start_l_star + (target_l_star - start_l_star) * time;
+        return TransitionCurveFromLStar<LightnessCurve>::Linear(l_star) * UINT16_MAX;
+    }
+
+    return (start_norm + (target_norm - start_norm) * time) * UINT16_MAX;
+}
+
+/*
+ *  Run golden transitions with given profile and check error, direction and end value
+ *
+ *  @param profile   Transition profile
+ */
+static void TestProfileGolden(TransitionProfile_T profile)
+{
+    double max_error     = 0.0;
+    double max_error_low = 0.0;
+
+    for (size_t i = 0; i < sizeof(GoldenTransitions) / sizeof(GoldenTransitions[0]); i++)
+    {
+        uint16_t           start      = GoldenTransitions[i][0];
+        uint16_t           target     = GoldenTransitions[i][1];
+        TransitionTiming_T timing       = CalculateTransitionTiming(GOLDEN_TRANSITION_MS);
+        Transition         transition   = CalculateTransition(start, target, &timing, profile);
+        uint16_t           previous     = start;
+        bool               is_monotonic = true;
+
+        for (uint32_t tick = 1; tick <= timing.ticks; tick++)
+        {
+            StepTransition(&transition);
+
+            uint16_t present  = GetPresentValue(&transition);
+            double   expected = ExpectedLightness(start, target, (double)tick / timing.ticks, profile);
+            double   error    = fabs(present - expected);
+
+            if (expected < GOLDEN_LOW_LIGHTNESS)
+                max_error_low = max(max_error_low, error);
+            else
+                max_error = max(max_error, error);
+
+            if ((target > start && present < previous) || (target < start && present > previous))
+                is_monotonic = false;
+            previous = present;
+        }
+
+        CHECK(is_monotonic);
+        CHECK(GetPresentValue(&transition) == target);
+        CHECK(transition.remaining_ticks == 0);
+    }
+
+    printf("Profile %d: max error %.1f, below lightness %u: %.1f\n", profile, max_error, GOLDEN_LOW_LIGHTNESS, max_error_low);
+
+    if (profile == TRANSITION_PROFILE_LINEAR)
+    {
+        CHECK(max_error <= GOLDEN_ERROR_MAX_LINEAR);
+        CHECK(max_error_low <= GOLDEN_ERROR_MAX_LINEAR);
+    }
+    else if (profile == TRANSITION_PROFILE_EASE_IN_OUT)
+    {
+        CHECK(max_error <= GOLDEN_ERROR_MAX_EASE);
+        CHECK(max_error_low <= GOLDEN_ERROR_MAX_EASE);
+    }
+    else
+    {
+        CHECK(max_error <= GOLDEN_ERROR_MAX_PERCEPTUAL);
+        CHECK(max_error_low <= GOLDEN_ERROR_MAX_PERCEPTUAL_LOW);
+    }
+}
+
+/*
+ *  Check that transition ending at present value doesn't change lightness by more than one L* step
+ *
+ *  @param profile   Transition profile
+ */
+static void TestProfileNoJump(TransitionProfile_T profile)
+{
+    for (uint32_t present = 1; present <= UINT16_MAX; present += 97)
+    {
+        TransitionTiming_T timing     = CalculateTransitionTiming(GOLDEN_TRANSITION_MS);
+        Transition         transition = CalculateTransition(present, present, &timing, profile);
+
+        StepTransition(&transition);
+        CHECK(abs((int32_t)GetPresentValue(&transition) - (int32_t)present) <= GOLDEN_JUMP_MAX);
+    }
+}
+
+/*
+ *  Compare random linear transitions with previous millis() based interpolation at every dimming interrupt
+ */
+static void TestLinearPrevious(void)
+{
+    int32_t max_error = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < PREVIOUS_TRANSITIONS; i++)
+    {
+        uint16_t start  = rand() & UINT16_MAX;
+        uint16_t target = rand() & UINT16_MAX;
+        uint32_t time   = PREVIOUS_TIME_MIN_MS + (uint32_t)rand() % (PREVIOUS_TIME_MAX_MS - PREVIOUS_TIME_MIN_MS);
+
+        TransitionTiming_T timing     = CalculateTransitionTiming(time);
+        Transition         transition = CalculateTransition(start, target, &timing, TRANSITION_PROFILE_LINEAR);
+
+        for (uint32_t tick = 1; tick <= timing.ticks; tick++)
+        {
+            StepTransition(&transition);
+
+            int32_t previous = PreviousPresentValue(start, target, time, tick * DIMM_INTERRUPT_TIME_MS);
+            max_error        = max(max_error, abs((int32_t)GetPresentValue(&transition) - previous));
+        }
+
+        CHECK(GetPresentValue(&transition) == target);
+    }
+
+    printf("Linear: max difference from previous math %d\n", max_error);
+    CHECK(max_error <= PREVIOUS_ERROR_MAX);
+}
+
+/*
+ *  Measure host time of dimming interrupt body during linear transition, as it is now and as it was before
+ *  transitions were stepped in fixed point
+ *
+ *  @param is_previous   Measure previous body: millis() interpolation and PWM output calculated with divisions
+ *  @param is_soft       Previous body divides bit by bit, as on Cortex-M0+
+ *  @return              Nanoseconds per interrupt
+ */
+static double BenchmarkInterrupt(bool is_previous, bool is_soft)
+{
+    TransitionTiming_T timing = CalculateTransitionTiming(UINT32_MAX / 2);
+    struct timespec    begin;
+    struct timespec    end;
+
+    Light[0]       = CalculateTransition(0, UINT16_MAX, &timing, TRANSITION_PROFILE_LINEAR);
+    Host_Millis    = 0;
+    IsSoftDivision = is_soft;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (uint32_t step = 0; step < BENCHMARK_STEPS; step++)
+    {
+        Host_Millis += DIMM_INTERRUPT_TIME_MS;
+
+        if (is_previous)
+        {
+            uint16_t val = PreviousPresentValue(0, UINT16_MAX, UINT32_MAX / 2, millis());
+            analogWrite(PIN_PWM_COLD, PreviousOutput(val));
+            analogWrite(PIN_PWM_WARM, 0);
+        }
+        else
+        {
+            DimmInterrupt();
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    IsSoftDivision = false;
+
+    double elapsed_ns = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+    return elapsed_ns / BENCHMARK_STEPS;
+}
+
+/*
+ *  Measure host time of dimming interrupt step
+ *
+ *  @param profile   Transition profile
+ *  @return          Nanoseconds per step
+ */
+static double BenchmarkStep(TransitionProfile_T profile)
+{
+    TransitionTiming_T timing     = CalculateTransitionTiming(UINT32_MAX / 2);
+    Transition         transition = CalculateTransition(0, UINT16_MAX, &timing, profile);
+    volatile uint32_t  sink       = 0;
+    struct timespec    begin;
+    struct timespec    end;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (uint32_t step = 0; step < BENCHMARK_STEPS; step++)
+    {
+        StepTransition(&transition);
+        sink = sink + transition.present_value;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed_ns = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+    return elapsed_ns / BENCHMARK_STEPS;
+}
+
+int main(void)
+{
+    TestProfileGolden(TRANSITION_PROFILE_LINEAR);
+    TestProfileGolden(TRANSITION_PROFILE);
+    TestProfileNoJump(TRANSITION_PROFILE);
+    TestLinearPrevious();
+
+    double linear_ns  = BenchmarkStep(TRANSITION_PROFILE_LINEAR);
+    double profile_ns = BenchmarkStep(TRANSITION_PROFILE);
+    printf("Step: linear %.1f ns, profile %d %.1f ns (host)\n", linear_ns, TRANSITION_PROFILE, profile_ns);
+
+    double previous_ns      = BenchmarkInterrupt(true, false);
+    double previous_soft_ns = BenchmarkInterrupt(true, true);
+    double interrupt_ns     = BenchmarkInterrupt(false, false);
+    printf("Interrupt: previous %.1f ns, with bitwise division %.1f ns, now %.1f ns (host)\n",
+           previous_ns,
+           previous_soft_ns,
+           interrupt_ns);
+
+    return Test_Result();
+}
@@ -0,0 +1,247 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+/*
+ *  Host simulation of a day of sensor reporting in an office. Counts Sensor Update Request frames sent with
+ *  reporting policies and as they were sent before, on every sample. Build and run with 'make test'.
+ */
+
+#include "MCU_Sensor.cpp"
+
+#include "Test.h"
+
+
+#define LOOP_INTERVAL_MS 10u                   /**< Simulated main loop period */
+#define DAY_MS (24u * 3600u * 1000u)           /**< Simulated time */
+#define OFFICE_OPEN_MS (8u * 3600u * 1000u)    /**< Office is occupied and lit from */
+#define OFFICE_CLOSE_MS (18u * 3600u * 1000u)  /**< Office is occupied and lit until */
+#define SUNRISE_MS (6u * 3600u * 1000u)        /**< Daylight starts */
+#define SUNSET_MS (20u * 3600u * 1000u)        /**< Daylight ends */
+#define DAYLIGHT_PEAK_ADC 700.0                /**< Ambient light sensor reading of daylight at noon */
+#define LUMINAIRE_ADC 150.0                    /**< Ambient light sensor reading of luminaire */
+#define ADC_NOISE 2                            /**< Ambient light sensor noise in ADC counts, peak */
+#define PIR_TRIGGER_INTERVAL_MS 30000u         /**< Average time between motions while office is occupied */
+#define PIR_PULSE_MS 2000u                     /**< Time PIR output stays high after motion */
+#define MAINS_VOLTAGE 230.0f                   /**< Mains voltage */
+#define MAINS_VOLTAGE_NOISE 0.5f               /**< Mains voltage noise, peak */
+#define CURRENT_IDLE 0.02f                     /**< Current drawn by luminaire in standby */
+#define CURRENT_LIT 0.30f                      /**< Current drawn by lit luminaire */
+#define CURRENT_NOISE 0.002f                   /**< Current noise, peak */
+#define POWER_FACTOR 0.95f                     /**< Power factor of luminaire */
+#define FRAMES_RATIO_MIN 50u                   /**< Previous reporting sends at least that many times more frames */
+
+
+/*
+ *  Frames sent for each sensor server instance
+ */
+typedef enum
+{
+    SENSOR_PIR,
+    SENSOR_ALS,
+    SENSOR_VOLT_CURR,
+    SENSOR_POW_ENERGY,
+    SENSOR_COUNT,
+} Sensor_T;
+
+
+static const char *SensorNames[SENSOR_COUNT] = {"PIR", "ALS", "voltage/current", "power/energy"};
+
+static SDM_State_T Meter = {};
+static uint32_t    Frames[SENSOR_COUNT];
+static uint32_t    LastFrameTimestamp[SENSOR_COUNT];
+static uint32_t    MaxFrameGap[SENSOR_COUNT];
+
+
+void ProcessLocalOccupancy(void)
+{
+}
+
+const SDM_State_T *SDM_GetState(void)
+{
+    return &Meter;
+}
+
+void UART_SendSensorUpdateRequest(uint8_t *p_payload, uint8_t len)
+{
+    Sensor_T sensor = (Sensor_T)p_payload[0];
+    uint32_t now    = millis();
+
+    CHECK(sensor < SENSOR_COUNT);
+    Frames[sensor]++;
+    MaxFrameGap[sensor]        = max(MaxFrameGap[sensor], now - LastFrameTimestamp[sensor]);
+    LastFrameTimestamp[sensor] = now;
+}
+
+
+/*
+ *  Random value in range
+ *
+ *  @param low       Lowest value
+ *  @param high      Highest value
+ *  @return          Value
+ */
+static float Random(float low, float high)
+{
+    return low + (high - low) * rand() / (float)RAND_MAX;
+}
+
+/*
+ *  Update ambient light sensor and meter for time of day
+ *
+ *  @param now       Time of day
+ *  @param is_lit    Luminaire is on
+ *  @param p_clouds  Cloud cover, 0.0 - 1.0, changes slowly
+ */
+static void UpdateEnvironment(uint32_t now, bool is_lit, float *p_clouds)
+{
+    double daylight = 0.0;
+    if (now > SUNRISE_MS && now < SUNSET_MS)
+    {
+        daylight = DAYLIGHT_PEAK_ADC * sin(M_PI * (now - SUNRISE_MS) / (SUNSET_MS - SUNRISE_MS));
+    }
+
+    *p_clouds = constrain(*p_clouds + Random(-0.002f, 0.002f), 0.0f, 0.6f);
+
+    int adc = daylight * (1.0f - *p_clouds) + (is_lit ? LUMINAIRE_ADC : 0.0) + (rand() % (2 * ADC_NOISE + 1)) - ADC_NOISE;
+    Host_AnalogInput[PIN_ALS] = constrain(adc, ANALOG_MIN, ANALOG_MAX);
+
+    Meter.voltage      = MAINS_VOLTAGE + Random(-MAINS_VOLTAGE_NOISE, MAINS_VOLTAGE_NOISE);
+    Meter.current      = (is_lit ? CURRENT_LIT : CURRENT_IDLE) + Random(-CURRENT_NOISE, CURRENT_NOISE);
+    Meter.active_power = Meter.voltage * Meter.current * POWER_FACTOR;
+    Meter.total_active_energy += Meter.active_power * LOOP_INTERVAL_MS / 3600000.0f;
+}
+
+/*
+ *  Count samples of previous main loop, which sent a frame for each of them
+ *
+ *  @param p_frames  [in, out] Frames sent for each sensor
+ *  @return          True if PIR was sampled
+ */
+static bool PreviousLoop(uint32_t *p_frames)
+{
+    static uint32_t timestamps[SENSOR_COUNT] = {};
+    static const uint32_t intervals[SENSOR_COUNT] = {
+        SENSOR_UPDATE_INTV_PIR,
+        SENSOR_UPDATE_INTV_ALS,
+        SENSOR_UPDATE_INTV_VOLT_CURR,
+        SENSOR_UPDATE_INTV_POW_ENERGY,
+    };
+
+    bool is_pir_sampled = false;
+    for (size_t sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        if (timestamps[sensor] + intervals[sensor] < millis())
+        {
+            timestamps[sensor] = millis();
+            p_frames[sensor]++;
+            is_pir_sampled = is_pir_sampled || (sensor == SENSOR_PIR);
+        }
+    }
+    return is_pir_sampled;
+}
+
+/*
+ *  Run a day in office and count frames sent
+ */
+static void SimulateDay(void)
+{
+    uint32_t previous_frames[SENSOR_COUNT] = {};
+    uint32_t pir_edges                     = 0;
+    uint32_t pir_pending_since             = 0;
+    bool     is_pir_pending                = false;
+    uint64_t previous_pir_delay_ms         = 0;
+    uint32_t pir_high_until                = 0;
+    float    clouds                        = 0.2f;
+
+    srand(1);
+    SetSensorServerPIRIdx(SENSOR_PIR);
+    SetSensorServerALSIdx(SENSOR_ALS);
+    SetSensorServerVoltCurrIdx(SENSOR_VOLT_CURR);
+    SetSensorServerPowEnergyIdx(SENSOR_POW_ENERGY);
+    SetupSensorServer();
+
+    for (Host_Millis = LOOP_INTERVAL_MS; Host_Millis < DAY_MS; Host_Millis += LOOP_INTERVAL_MS)
+    {
+        uint32_t now         = Host_Millis;
+        bool     is_occupied = now >= OFFICE_OPEN_MS && now < OFFICE_CLOSE_MS;
+
+        UpdateEnvironment(now, is_occupied, &clouds);
+
+        Host_DigitalInput[PIN_PIR] = now < pir_high_until;
+        if (is_occupied && (uint32_t)rand() % (PIR_TRIGGER_INTERVAL_MS / LOOP_INTERVAL_MS) == 0)
+        {
+            if (!Host_DigitalInput[PIN_PIR])
+            {
+                Host_DigitalInput[PIN_PIR] = HIGH;
+                pir_edges++;
+                pir_pending_since = now;
+                is_pir_pending    = true;
+
+                // Presence is reported in the same loop iteration, unless it is reported already
+                InterruptPIR();
+                LoopSensorServer();
+                CHECK(PirReport.is_reported && PirReport.values[0] == 1);
+            }
+            pir_high_until = now + PIR_PULSE_MS;
+        }
+
+        LoopSensorServer();
+
+        if (PreviousLoop(previous_frames) && is_pir_pending)
+        {
+            previous_pir_delay_ms += now - pir_pending_since;
+            is_pir_pending = false;
+        }
+    }
+
+    uint32_t frames          = 0;
+    uint32_t previous_total = 0;
+    for (size_t sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        printf("%s: %u frames, previously %u, longest gap %u s\n",
+               SensorNames[sensor],
+               Frames[sensor],
+               previous_frames[sensor],
+               MaxFrameGap[sensor] / 1000);
+
+        frames += Frames[sensor];
+        previous_total += previous_frames[sensor];
+
+        CHECK(MaxFrameGap[sensor] <= SENSOR_REPORT_HEARTBEAT_INTV + SENSOR_UPDATE_INTV_POW_ENERGY + LOOP_INTERVAL_MS);
+    }
+
+    printf("Day: %u frames, previously %u; %u PIR edges reported at once, previously after %.0f ms on average\n",
+           frames,
+           previous_total,
+           pir_edges,
+           (double)previous_pir_delay_ms / pir_edges);
+
+    CHECK(pir_edges > 0);
+    CHECK(frames * FRAMES_RATIO_MIN < previous_total);
+}
+
+int main(void)
+{
+    SimulateDay();
+
+    return Test_Result();
+}
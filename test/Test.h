@@ -0,0 +1,86 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TEST_H_
+#define TEST_H_
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+static int Failures = 0; /**< Number of failed checks */
+
+
+#define CHECK(_condition)                                                          \
+    do                                                                             \
+    {                                                                              \
+        if (!(_condition))                                                         \
+        {                                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #_condition); \
+            Failures++;                                                            \
+        }                                                                          \
+    } while (0)
+
+
+/*
+ *  Print result of all checks
+ *
+ *  @return          Exit code of test program
+ */
+static inline int Test_Result(void)
+{
+    if (Failures != 0)
+    {
+        printf("%d checks failed\n", Failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
+
+/*
+ *  Divide bit by bit, as run time library does on Cortex-M0+ which has no divide instruction.
+ *  Used to time previous math in benchmarks, host divider hides its cost.
+ *
+ *  @param dividend  Dividend
+ *  @param divisor   Divisor
+ *  @param bits      Width of division, 32 or 64
+ *  @return          Quotient
+ */
+static inline uint64_t Test_SoftDivide(uint64_t dividend, uint64_t divisor, uint32_t bits)
+{
+    uint64_t quotient  = 0;
+    uint64_t remainder = 0;
+    for (int32_t bit = bits - 1; bit >= 0; bit--)
+    {
+        remainder = (remainder << 1) | ((dividend >> bit) & 1u);
+        if (remainder >= divisor)
+        {
+            remainder -= divisor;
+            quotient |= 1ull << bit;
+        }
+    }
+    return quotient;
+}
+
+#endif    // TEST_H_
@@ -0,0 +1,105 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "Arduino.h"
+#include "TimerOne.h"
+#include "TimerThree.h"
+
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+HardwareSerial Serial3;
+TimerOne       Timer1;
+TimerThree     Timer3;
+
+uint32_t Host_Millis = 0;
+int      Host_AnalogOutput[HOST_PIN_COUNT];
+int      Host_AnalogInput[HOST_PIN_COUNT];
+uint8_t  Host_DigitalInput[HOST_PIN_COUNT];
+
+
+uint32_t millis(void)
+{
+    return Host_Millis;
+}
+
+uint32_t micros(void)
+{
+    return Host_Millis * 1000;
+}
+
+void delay(uint32_t ms)
+{
+    Host_Millis += ms;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+uint8_t digitalRead(uint8_t pin)
+{
+    return Host_DigitalInput[pin];
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+    Host_AnalogOutput[pin] = val;
+}
+
+int analogRead(uint8_t pin)
+{
+    return Host_AnalogInput[pin];
+}
+
+void analogWriteResolution(uint32_t bits)
+{
+}
+
+void analogReadResolution(unsigned int bits)
+{
+}
+
+void analogReadAveraging(unsigned int num)
+{
+}
+
+void attachInterrupt(uint8_t interrupt, void (*p_isr)(void), int mode)
+{
+}
+
+void noInterrupts(void)
+{
+}
+
+void interrupts(void)
+{
+}
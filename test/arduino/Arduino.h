@@ -0,0 +1,97 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ *  Host replacement of Arduino core, used by tests in place of Teensyduino.
+ *  Time advances only when test sets Host_Millis, analog outputs and inputs are plain arrays.
+ */
+
+#ifndef ARDUINO_H_
+#define ARDUINO_H_
+
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#define FALLING 2
+#define RISING 3
+#define CHANGE 4
+
+#define HOST_PIN_COUNT 64 /**< Number of simulated pins */
+
+#define lowByte(w) ((uint8_t)((w)&0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(pin) (pin)
+
+
+class HardwareSerial
+{
+  public:
+    void   begin(uint32_t baud) {}
+    int    printf(const char *format, ...) { return 0; }
+    int    available(void) { return 0; }
+    int    read(void) { return -1; }
+    size_t write(uint8_t byte) { return 1; }
+    size_t write(const uint8_t *p_buffer, size_t len) { return len; }
+    void   flush(void) {}
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+
+/**< Simulated hardware state, set and read by tests */
+extern uint32_t Host_Millis;
+extern int      Host_AnalogOutput[HOST_PIN_COUNT];
+extern int      Host_AnalogInput[HOST_PIN_COUNT];
+extern uint8_t  Host_DigitalInput[HOST_PIN_COUNT];
+
+uint32_t millis(void);
+uint32_t micros(void);
+void     delay(uint32_t ms);
+void     delayMicroseconds(uint32_t us);
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t val);
+uint8_t  digitalRead(uint8_t pin);
+void     analogWrite(uint8_t pin, int val);
+int      analogRead(uint8_t pin);
+void     analogWriteResolution(uint32_t bits);
+void     analogReadResolution(unsigned int bits);
+void     analogReadAveraging(unsigned int num);
+void     attachInterrupt(uint8_t interrupt, void (*p_isr)(void), int mode);
+void     noInterrupts(void);
+void     interrupts(void);
+
+#endif    // ARDUINO_H_
@@ -0,0 +1,47 @@
+/*
+Copyright © 2017 Silvair Sp. z o.o. All Rights Reserved.
+ 
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished
+to do so, subject to the following conditions:
+ 
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+ 
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS
+OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+ *  Host replacement of Teensy TimerOne library. Interrupt is called by test.
+ */
+
+#ifndef TIMER_ONE_H_
+#define TIMER_ONE_H_
+
+
+#include <stddef.h>
+
+
+class TimerOne
+{
+  public:
+    void initialize(long period_us) {}
+    void attachInterrupt(void (*p_isr)(void)) { Isr = p_isr; IsRunning = true; }
+    void start(void) { IsRunning = true; }
+    void stop(void) { IsRunning = false; }
+
+    void (*Isr)(void) = NULL; /**< Attached interrupt */
+    bool IsRunning    = false;
+};
+
+extern TimerOne Timer1;
+
+#endif    // TIMER_ONE_H_
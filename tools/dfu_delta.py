@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+Generate delta DFU image against firmware running on the device.
+
+Output image starts with 12 bytes header (magic "SDFU", format, 3 reserved bytes,
+little endian decoded image size) followed by a list of operations:
+  0x00, length (2 bytes LE), data      - insert new bytes
+  0x01, offset (3 bytes LE), length (2 bytes LE) - copy bytes from running firmware at offset
+MCU applies operations page by page directly into the DFU space. The base firmware has
+to be exactly the binary running on the device, SHA256 in DFU Init Request has to be
+calculated over the new firmware, it is printed by this tool.
+
+Usage: dfu_delta.py running.bin new.bin update.sdfu
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+DFU_IMAGE_MAGIC = b"SDFU"
+DFU_IMAGE_FORMAT_DELTA = 0x02
+
+DELTA_OP_INSERT = 0x00
+DELTA_OP_COPY = 0x01
+DELTA_MAX_LEN = 0xFFFF
+
+BLOCK_LEN = 8           # Length of indexed base firmware blocks
+MIN_COPY_LEN = 12       # Shorter matches are cheaper to insert
+MAX_CANDIDATES = 16     # Number of remembered base positions per block
+
+# Flash config field is overwritten by the flasher, its content in running flash may differ from base binary.
+FLASH_CONFIG_FIELD = (0x40, 0x44)
+
+
+def _index(base):
+    index = {}
+    for pos in range(len(base) - BLOCK_LEN + 1):
+        candidates = index.setdefault(base[pos:pos + BLOCK_LEN], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+    return index
+
+
+def _match_len(base, new, src, dst):
+    length = 0
+    limit = min(len(base) - src, len(new) - dst)
+    while length < limit and base[src + length] == new[dst + length]:
+        if FLASH_CONFIG_FIELD[0] <= src + length < FLASH_CONFIG_FIELD[1]:
+            break
+        length += 1
+    return length
+
+
+def _emit_insert(out, data):
+    for pos in range(0, len(data), DELTA_MAX_LEN):
+        chunk = data[pos:pos + DELTA_MAX_LEN]
+        out += struct.pack("<BH", DELTA_OP_INSERT, len(chunk)) + chunk
+
+
+def _emit_copy(out, src, length):
+    while length:
+        chunk = min(length, DELTA_MAX_LEN)
+        out += struct.pack("<BHBH", DELTA_OP_COPY, src & 0xFFFF, src >> 16, chunk)
+        src += chunk
+        length -= chunk
+
+
+def diff(base, new):
+    index = _index(base)
+    out = bytearray()
+    pending = bytearray()
+    pos = 0
+    last_delta = 0
+
+    while pos < len(new):
+        best_src, best_len = None, 0
+
+        # Code usually moves as a whole, try to continue previous displacement first.
+        for src in [pos + last_delta] + index.get(new[pos:pos + BLOCK_LEN], []):
+            if 0 <= src < len(base):
+                length = _match_len(base, new, src, pos)
+                if length > best_len:
+                    best_src, best_len = src, length
+
+        if best_len < MIN_COPY_LEN:
+            pending.append(new[pos])
+            pos += 1
+            continue
+
+        _emit_insert(out, bytes(pending))
+        pending = bytearray()
+        _emit_copy(out, best_src, best_len)
+        last_delta = best_src - pos
+        pos += best_len
+
+    _emit_insert(out, bytes(pending))
+    return bytes(out)
+
+
+def pack(base, new):
+    header = DFU_IMAGE_MAGIC + struct.pack("<B3xI", DFU_IMAGE_FORMAT_DELTA, len(new))
+    return header + diff(base, new)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate delta DFU image against running firmware.")
+    parser.add_argument("base", help="firmware binary running on the device")
+    parser.add_argument("input", help="new firmware binary")
+    parser.add_argument("output", help="delta DFU image")
+    args = parser.parse_args()
+
+    with open(args.base, "rb") as f:
+        base = f.read()
+    with open(args.input, "rb") as f:
+        new = f.read()
+
+    image = pack(base, new)
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+    print("Firmware size: %d" % len(new))
+    print("Image size:    %d (%.1f%%)" % (len(image), 100.0 * len(image) / max(len(new), 1)))
+    print("SHA256:        %s" % hashlib.sha256(new).hexdigest())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
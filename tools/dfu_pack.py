@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+Pack firmware binary into compressed DFU image.
+
+Output image starts with 12 bytes header (magic "SDFU", format, 3 reserved bytes,
+little endian decoded image size) followed by a single LZ4 block. MCU decodes
+the stream page by page directly into the DFU space, SHA256 in DFU Init Request
+has to be calculated over the decoded (original) firmware, it is printed by this tool.
+
+Usage: dfu_pack.py firmware.bin firmware.sdfu
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+DFU_IMAGE_MAGIC = b"SDFU"
+DFU_IMAGE_FORMAT_LZ4 = 0x01
+
+LZ4_MIN_MATCH = 4
+LZ4_MAX_OFFSET = 0xFFFF
+LZ4_LAST_LITERALS = 5
+LZ4_MFLIMIT = 12
+HASH_LOG = 16
+
+
+def _write_len(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def _write_sequence(out, literals, match_len):
+    lit_len = len(literals)
+    token = min(lit_len, 15) << 4
+    if match_len is not None:
+        token |= min(match_len - LZ4_MIN_MATCH, 15)
+    out.append(token)
+    if lit_len >= 15:
+        _write_len(out, lit_len - 15)
+    out += literals
+
+
+def lz4_compress(data):
+    """Greedy LZ4 block compressor with single hash table."""
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    limit = len(data) - LZ4_MFLIMIT
+
+    while pos < limit:
+        key = data[pos:pos + LZ4_MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = pos
+
+        if candidate is None or pos - candidate > LZ4_MAX_OFFSET:
+            pos += 1
+            continue
+
+        match_len = LZ4_MIN_MATCH
+        max_len = len(data) - LZ4_LAST_LITERALS - pos
+        while match_len < max_len and data[candidate + match_len] == data[pos + match_len]:
+            match_len += 1
+
+        _write_sequence(out, data[anchor:pos], match_len)
+        out += struct.pack("<H", pos - candidate)
+        if match_len - LZ4_MIN_MATCH >= 15:
+            _write_len(out, match_len - LZ4_MIN_MATCH - 15)
+
+        for i in range(pos + 1, min(pos + match_len, limit)):
+            table[data[i:i + LZ4_MIN_MATCH]] = i
+        pos += match_len
+        anchor = pos
+
+    _write_sequence(out, data[anchor:], None)
+    return bytes(out)
+
+
+def pack(firmware):
+    header = DFU_IMAGE_MAGIC + struct.pack("<B3xI", DFU_IMAGE_FORMAT_LZ4, len(firmware))
+    return header + lz4_compress(firmware)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack firmware binary into compressed DFU image.")
+    parser.add_argument("input", help="firmware binary")
+    parser.add_argument("output", help="compressed DFU image")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        firmware = f.read()
+
+    image = pack(firmware)
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+
+    print("Firmware size: %d" % len(firmware))
+    print("Image size:    %d (%.1f%%)" % (len(image), 100.0 * len(image) / max(len(firmware), 1)))
+    print("SHA256:        %s" % hashlib.sha256(firmware).hexdigest())
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())